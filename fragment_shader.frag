@@ -1,7 +1,12 @@
 #version 450
 
+layout(set=0,binding=0) uniform sampler2D trail_map;
+
+layout(location=0) in vec2 i_uv;
+
 layout(location=0) out vec4 o_color;
 
 void main(){
-    o_color=vec4(1.0,1.0,1.0,1.0);
+    float trail=texture(trail_map,i_uv).x;
+    o_color=vec4(trail,trail,trail,1.0);
 }
\ No newline at end of file
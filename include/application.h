@@ -7,6 +7,9 @@
 #include <memory>
 #include <functional>
 #include <optional>
+#include <chrono>
+#include <random>
+#include <string>
 
 #include <vulkan/vulkan.h>
 
@@ -32,23 +35,173 @@ struct defer{
 
 #include <application/vulkan_context.h>
 #include <application/vulkan_error.h>
+#include <application/device_selection.h>
+#include <application/pipeline_cache.h>
+#include <application/shader_registry.h>
+#include <application/staging_ring.h>
+#include <application/timeline.h>
+#include <application/deletion_queue.h>
+#include <application/gpu_profiler.h>
 #include <application/window.h>
+#include <application/simulation.h>
+#include <application/cpu_simulation.h>
 
 class GraphicsPipeline{
+    private:
+        std::shared_ptr<VulkanContext> vulkan;
+
     public:
         VkPipelineLayout layout;
         VkPipeline handle;
 
+        /// fullscreen triangle pipeline, viewport and scissor are dynamic state
         GraphicsPipeline(
             std::shared_ptr<VulkanContext> vulkan,
-            VkRenderPass vk_render_pass
+            VkRenderPass vk_render_pass,
+            const std::vector<VkDescriptorSetLayout> &descriptor_set_layouts
         );
+        GraphicsPipeline(GraphicsPipeline&)=delete;
+        GraphicsPipeline(GraphicsPipeline&&)=delete;
+
+        ~GraphicsPipeline();
+};
+
+class ComputePipeline{
+    private:
+        std::shared_ptr<VulkanContext> vulkan;
+
+    public:
+        VkPipelineLayout layout;
+        VkPipeline handle;
+
+        /// pipeline with a single compute stage (entry point main) and one push constant range starting at offset 0
+        ComputePipeline(
+            std::shared_ptr<VulkanContext> vulkan,
+            std::string shader_filepath,
+            const std::vector<VkDescriptorSetLayout> &descriptor_set_layouts,
+            uint32_t push_constant_size
+        );
+        ComputePipeline(ComputePipeline&)=delete;
+        ComputePipeline(ComputePipeline&&)=delete;
+
+        ~ComputePipeline();
+};
+
+enum class FramePacing{
+    /// render as fast as possible, presenting without waiting for vertical blank if the surface allows it
+    Uncapped,
+    /// present in sync with the display refresh rate
+    VSync,
+    /// render as fast as possible, but no faster than ApplicationOptions::target_fps
+    TargetFps,
+};
+
+enum class SimulationBackend{
+    /// compute shaders, see SlimeSimulation
+    Gpu,
+    /// CpuSlimeSimulation, the trail map is uploaded every frame for rendering
+    Cpu,
+};
+
+struct ApplicationOptions{
+    /// number of frames the cpu may record ahead of the gpu
+    uint32_t frames_in_flight=2;
+
+    DeviceSelectionOptions device_selection;
+
+    SimulationParameters simulation;
+    SimulationBackend simulation_backend=SimulationBackend::Gpu;
+    /// threads of the cpu simulation including the main thread, 0 uses one per hardware thread
+    size_t cpu_simulation_threads=0;
+    /// run simulation steps on a compute only queue if the device has one and supports timeline semaphores,
+    /// so that each step overlaps with drawing the previous one. not used by the cpu backend
+    bool async_compute=true;
+
+    /// directory the pipeline cache is loaded from and saved to, empty disables the pipeline cache
+    std::string pipeline_cache_directory=".";
+
+    /// measure gpu time of each pass with timestamp queries
+    bool gpu_profiling=true;
+    /// print the gpu timings every this many steps, 0 only prints them on exit
+    uint64_t gpu_profile_report_interval=0;
+
+    FramePacing frame_pacing=FramePacing::VSync;
+    /// only used with FramePacing::TargetFps
+    double target_fps=60.0;
+    /// present mode and number of swapchain images, by default PowerSaving with FramePacing::VSync and LowLatency otherwise
+    std::optional<SwapchainPolicy> swapchain_policy;
+    /// between frames, block on window events instead of polling them once per frame
+    /// input is then handled as soon as it arrives, and nothing runs at all while paused
+    bool wait_for_events=true;
+
+    /// render into an offscreen image instead of a window, no display server or presentation support is required
+    /// frame pacing other than FramePacing::TargetFps is ignored, i.e. frames are produced as fast as the device allows
+    bool headless=false;
+    uint32_t headless_width=500;
+    uint32_t headless_height=500;
+    /// in headless mode, skip drawing the trail map into the offscreen image and only run the simulation
+    bool headless_render=true;
+
+    /// stop after this many simulation steps, 0 runs until the window is closed
+    uint64_t max_steps=0;
+    /// simulation steps recorded into each frame's submission, only the last of them is drawn
+    /// a frame ends early on steps that are read back, reported or max_steps, so the same steps are observed as
+    /// when single stepping. on the gpu, agents sharing a pixel race on its deposit, so results only match
+    /// single stepping (or any other run) up to that race, the cpu backend is deterministic
+    uint32_t steps_per_frame=1;
+
+    /// size of the host visible ring buffer used for uploads and readbacks
+    VkDeviceSize staging_ring_size=16ull<<20;
+    /// number of agents spawned at the pointer per click
+    uint32_t agents_per_click=4096;
+    /// write the trail map to trail_readback_directory every this many steps, 0 disables readback
+    uint64_t trail_readback_interval=0;
+    std::string trail_readback_directory=".";
+};
+
+/// resources used by a single frame in flight
+struct FrameResources{
+    VkCommandBuffer command_buffer;
+    std::shared_ptr<Semaphore> image_available_semaphore;
+    std::shared_ptr<Semaphore> rendering_finished_semaphore;
+    /// signaled once the gpu is done with this frame
+    std::shared_ptr<Fence> in_flight_fence;
+
+    /// transfer queue work of this frame, recorded before (uploads) and after (readbacks) the graphics work
+    VkCommandBuffer upload_command_buffer;
+    VkCommandBuffer readback_command_buffer;
+    std::shared_ptr<Semaphore> upload_finished_semaphore;
+    std::shared_ptr<Semaphore> readback_ready_semaphore;
+    std::shared_ptr<Semaphore> readback_finished_semaphore;
+    /// signaled once the transfer queue is done with this frame, only meaningful if transfer_submitted
+    std::shared_ptr<Fence> transfer_fence;
+    bool transfer_submitted=false;
+    /// upload_command_buffer has been recorded for this frame and is waiting to be submitted
+    bool upload_recorded=false;
+
+    /// simulation steps of this frame on the async compute queue, VK_NULL_HANDLE without async compute
+    VkCommandBuffer compute_command_buffer=VK_NULL_HANDLE;
+    /// number of steps recorded into compute_command_buffer that are waiting to be submitted
+    uint32_t compute_steps=0;
+    /// number of steps recorded into command_buffer, i.e. on the graphics queue, that are waiting to be submitted
+    uint32_t graphics_steps=0;
+    /// only without timeline semaphores, signaled by the graphics submission if it runs steps
+    /// see Application::pending_steps_semaphore
+    std::shared_ptr<Semaphore> steps_finished_semaphore=nullptr;
+};
+
+/// draw of the trail map into one framebuffer, recorded once since it only depends on the framebuffer and the trail image
+struct RenderCommands{
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    /// secondary command buffers inside the render pass, index i samples trail image i
+    VkCommandBuffer draw_command_buffers[2];
 };
 
 class Application{
     private:
         #ifdef VK_USE_PLATFORM_XCB_KHR
-            xcb_connection_t *xcb_connection;
+            xcb_connection_t *xcb_connection=nullptr;
         #endif
 
         std::shared_ptr<VulkanContext> vulkan;
@@ -57,24 +210,149 @@ class Application{
         uint32_t vk_graphics_queue_family_index;
         VkQueue vk_present_queue;
         uint32_t vk_present_queue_family_index;
+        /// dedicated transfer queue if the device has one, otherwise the graphics queue
+        VkQueue vk_transfer_queue;
+        uint32_t vk_transfer_queue_family_index;
+        /// compute only queue the simulation steps run on, only if async_compute
+        VkQueue vk_compute_queue=VK_NULL_HANDLE;
+        uint32_t vk_compute_queue_family_index=UINT32_MAX;
+        bool async_compute=false;
 
         VkRenderPass vk_render_pass;
 
-        VkSemaphore vk_image_available_semaphore_handle;
-        std::shared_ptr<Semaphore> vk_image_available_semaphore;
-        VkSemaphore vk_rendering_finished_semaphore_handle;
-        std::shared_ptr<Semaphore> vk_rendering_finished_semaphore;
+        ApplicationOptions options;
+
         VkCommandPool present_vk_command_pool;
         std::vector<VkCommandBuffer> present_command_buffers;
         VkCommandPool graphics_vk_command_pool;
         std::vector<VkCommandBuffer> graphics_command_buffers;
+        VkCommandPool transfer_vk_command_pool;
+        std::vector<VkCommandBuffer> transfer_command_buffers;
+        VkCommandPool compute_vk_command_pool=VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> compute_command_buffers;
+        /// secondary command buffers of a step from either trail image, see SlimeSimulation::prerecord_steps
+        /// allocated from the pool of the queue the steps run on, empty with the cpu backend
+        std::vector<VkCommandBuffer> step_command_buffers;
+        /// one per swapchain framebuffer, or only the offscreen framebuffer if headless, allocated from graphics_vk_command_pool
+        std::vector<RenderCommands> render_commands;
+
+        /// VK_KHR_timeline_semaphore is enabled, which async compute and VulkanContext::deletion_queue require
+        bool timeline_semaphores=false;
+        /// signaled by every submission to the respective queue, only if timeline_semaphores
+        std::shared_ptr<Timeline> graphics_timeline;
+        std::shared_ptr<Timeline> transfer_timeline;
+        /// only with async compute
+        std::shared_ptr<Timeline> compute_timeline;
+        /// graphics_timeline value of the last submission that drew the result of an even (0) or odd (1) step
+        /// a step overwrites the trail image of the step two before it, so it must wait for the one with its own parity
+        uint64_t last_render_of_step_parity[2]={0,0};
+        /// the last graphics submission that sampled trail image 0 or 1, a trail map upload of the cpu simulation
+        /// must wait for it before overwriting the image
+        /// with timeline semaphores its graphics_timeline value, the upload submission waits on it
+        uint64_t last_draw_of_trail_image[2]={0,0};
+        /// without timeline semaphores the index into frames of the submission, whose in_flight_fence the host waits on
+        uint32_t last_draw_frame_of_trail_image[2]={UINT32_MAX,UINT32_MAX};
+        /// timestamps of the simulation steps on the async compute queue, see VulkanContext::gpu_profiler
+        std::shared_ptr<GpuProfiler> compute_profiler;
+
+        std::vector<FrameResources> frames;
+        /// index into frames
+        uint32_t current_frame=0;
+        /// fence of the frame that last rendered into each swapchain image, VK_NULL_HANDLE if none
+        std::vector<VkFence> swapchain_image_fences;
+
+        std::chrono::steady_clock::time_point next_frame_time;
+
+        std::shared_ptr<SlimeSimulation> simulation;
+        /// only set with SimulationBackend::Cpu, simulation then only holds the trail images for rendering
+        std::shared_ptr<CpuSlimeSimulation> cpu_simulation;
+        std::shared_ptr<GraphicsPipeline> graphics_pipeline;
+
+        std::shared_ptr<StagingRing> staging_ring;
+        /// agents to upload with the next frame
+        std::vector<Agent> pending_agent_spawns;
+        /// next agent to be replaced by a spawned agent
+        uint32_t agent_spawn_cursor=0;
+        std::mt19937 agent_spawn_random;
+        /// last pointer position in window coordinates
+        float pointer_x=0.0;
+        float pointer_y=0.0;
+        /// readback of the previous frame, the next graphics submission must wait for it before overwriting the trail map
+        VkSemaphore pending_readback_semaphore=VK_NULL_HANDLE;
+        /// agent uploads must wait for the steps that were submitted before them, since those read the agents
+        /// with timeline semaphores, graphics_timeline value of the last graphics submission that ran steps
+        /// (steps on the async compute queue are covered by the latest compute_timeline value)
+        uint64_t last_graphics_steps_value=0;
+        /// without timeline semaphores, signaled by the last graphics submission that ran steps, and waited on by the
+        /// next agent upload or, if there is none, by the next graphics submission
+        VkSemaphore pending_steps_semaphore=VK_NULL_HANDLE;
 
         bool should_keep_running=true;
         bool should_resize_window=false;
+        /// no simulation steps are run while paused, frames are only drawn if redraw_requested
+        bool paused=false;
+        /// the window contents have been lost, e.g. after being uncovered
+        bool redraw_requested=false;
 
         std::shared_ptr<Window> window;
 
+        /// render target in headless mode, in place of the swapchain images
+        VkFormat offscreen_format=VK_FORMAT_R8G8B8A8_UNORM;
+        VkImage offscreen_image=VK_NULL_HANDLE;
+        MemoryAllocation offscreen_image_memory;
+        VkImageView offscreen_image_view=VK_NULL_HANDLE;
+        VkFramebuffer offscreen_framebuffer=VK_NULL_HANDLE;
+
+        /// record render_commands for the current framebuffers, the previous ones are freed once no frame uses them
+        /// must be called again whenever the framebuffers are recreated
+        void record_render_commands();
+        /// record num_steps simulation steps and, unless render is nullptr, the trail map draw of the latest step
+        /// if present_image is not VK_NULL_HANDLE it is transitioned for presentation afterwards
+        void record_frame(
+            VkCommandBuffer command_buffer,
+            uint32_t num_steps,
+            const RenderCommands *render,
+            VkImage present_image
+        );
+        /// run_step without window events, swapchain image acquisition and presentation
+        void run_headless_step();
+
+        /// wait until the transfer queue is done with this frame slot, and release its staging regions
+        void wait_for_frame_transfers(FrameResources &frame);
+        /// number of simulation steps the next frame runs, up to steps_per_frame, 0 while paused
+        uint32_t steps_this_frame()const;
+        /// apply pending agent spawns and run num_steps steps of the cpu simulation
+        void step_cpu_simulation(uint32_t num_steps);
+        /// record the uploads of this frame (spawned agents or the cpu trail map), if any, before its graphics work
+        void record_uploads(FrameResources &frame);
+        /// record the simulation steps of this frame into its compute command buffer, for the async compute queue
+        void record_compute_steps(FrameResources &frame,uint32_t num_steps);
+        /// submit the frame's graphics work, surrounded by recorded uploads and trail map readback on the transfer queue
+        /// and preceded by the recorded step on the async compute queue
+        void submit_frame(
+            FrameResources &frame,
+            std::vector<VkSemaphore> wait_semaphores,
+            std::vector<VkPipelineStageFlags> wait_stages,
+            std::vector<VkSemaphore> signal_semaphores
+        );
+        /// queue agents_per_click agents around the pointer for upload with the next frame
+        void spawn_agents_at_pointer();
+        void write_trail_map(uint64_t step,const Field2D &trail_map)const;
+
+        /// handle input and window events received since the last call
+        void handle_window_events();
+        /// sleep until the next frame is due according to ApplicationOptions::target_fps
+        void wait_for_next_frame();
+        /// advance next_frame_time by one frame, without catching up on missed frames
+        void advance_next_frame_time();
+        /// with ApplicationOptions::wait_for_events, returns true if a frame is due, otherwise blocks until either
+        /// window events arrive or the next frame is due and returns false
+        bool wait_for_frame_or_events();
+
     public:
+        /// x11 keycode of the space bar, toggles pause
+        static constexpr int PAUSE_KEY=65;
+
         static std::vector<VkLayerProperties> enumerateInstanceLayerProperties(){
             uint32_t supported_num_instance_layer_properties=0;
             vkEnumerateInstanceLayerProperties(
@@ -106,7 +384,7 @@ class Application{
             return supported_instance_extension_properties;
         }
 
-        Application();
+        Application(const ApplicationOptions &options={});
         Application(Application&)=delete;
         Application(Application&&)=delete;
 
@@ -115,12 +393,48 @@ class Application{
         /// run main event loop until window is closed
         void run_forever();
 
+        /// block until all submitted work is complete
+        void wait_idle()const{
+            if(!timeline_semaphores){
+                vulkan->deviceWaitIdle();
+                return;
+            }
+            for(const auto &timeline:{graphics_timeline,transfer_timeline,compute_timeline}){
+                if(timeline){
+                    timeline->wait_idle();
+                }
+            }
+        }
+        /// number of simulation steps recorded so far
+        uint64_t step_index()const{
+            return cpu_simulation?cpu_simulation->step_index:simulation->step_index;
+        }
+        /// nullptr if gpu profiling is disabled
+        const GpuProfiler* gpu_profiler()const{
+            return vulkan->gpu_profiler.get();
+        }
+        /// timings of all profiled queues, sorted by scope name
+        std::vector<GpuScopeTimings> gpu_timings()const;
+        /// forget the timings of all profiled queues so far, see GpuProfiler::reset_history
+        void reset_gpu_timings();
+        void print_gpu_report()const;
+        /// simulation steps run on a compute only queue, see ApplicationOptions::async_compute
+        bool async_compute_enabled()const{
+            return async_compute;
+        }
+        VkPhysicalDeviceProperties physical_device_properties()const{
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vulkan->physical_device,&properties);
+            return properties;
+        }
+
         ~Application();
 
         std::shared_ptr<Window> create_window(
             int width,
             int height,
-            std::optional<std::shared_ptr<VulkanContext>> override_context = {}
+            std::optional<std::shared_ptr<VulkanContext>> override_context = {},
+            SwapchainPolicy swapchain_policy = SwapchainPolicy::PowerSaving
         ){
             if(override_context){
                 std::shared_ptr<Window> window=std::make_shared<Window>(
@@ -129,7 +443,8 @@ class Application{
                     #endif
                     *override_context,
                     width,
-                    height
+                    height,
+                    swapchain_policy
                 );
                 return window;
             }else{
@@ -139,7 +454,8 @@ class Application{
                     #endif
                     vulkan,
                     width,
-                    height
+                    height,
+                    swapchain_policy
                 );
                 return window;
             }
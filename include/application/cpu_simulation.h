@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <field2d.hpp>
+#include <work_stealing_pool.hpp>
+
+#include <application/simulation.h>
+
+/// slime mold agent simulation on the cpu, the reference for SlimeSimulation
+///
+/// runs the same kernels as the compute shaders: agents sense, rotate and move in parallel on the
+/// current trail map, the current trail map is blurred and decayed into the other trail map, then the agents
+/// deposit into the other trail map.
+/// agents are stored as separate arrays per component, trail maps as Field2D.
+/// unlike on the gpu, where agents sharing a pixel race on its deposit, all deposits are counted, which
+/// makes every step deterministic and independent of the number of threads.
+/// sums are evaluated in the same order as in the shaders, but results still only match the gpu within a
+/// tolerance: vulkan allows less precise division, sin and cos, and the compiler may contract mix into fma.
+class CpuSlimeSimulation{
+    private:
+        WorkStealingPool thread_pool;
+
+        std::vector<float> agent_x;
+        std::vector<float> agent_y;
+        std::vector<float> agent_angle;
+
+        /// ping-ponged like the trail images of SlimeSimulation
+        Field2D trail_maps[2];
+        uint32_t current_trail_index=0;
+        /// agents in each pixel after moving, row-major without padding
+        /// counted with relaxed atomics, the order of deposits does not matter
+        std::vector<std::atomic<uint32_t>> deposit_counts;
+
+        /// sense, rotate and move agents [begin,end) on the current trail map, and count their deposits
+        void update_agents(size_t begin,size_t end);
+        /// add the counted deposits of rows [begin,end) to the other trail map
+        void deposit_rows(size_t begin,size_t end);
+        /// blur and decay rows [begin,end) of the current into the other trail map
+        void diffuse_rows(size_t begin,size_t end);
+
+    public:
+        /// agents per work item of the agent update
+        static constexpr size_t AGENT_GRAIN=4096;
+        /// rows per tile of the deposit and diffusion
+        static constexpr size_t TILE_ROWS=16;
+
+        SimulationParameters parameters;
+        uint64_t step_index=0;
+
+        /// num_threads includes the calling thread, 0 uses one thread per hardware thread
+        CpuSlimeSimulation(const SimulationParameters &parameters,size_t num_threads=0);
+        CpuSlimeSimulation(CpuSlimeSimulation&)=delete;
+        CpuSlimeSimulation(CpuSlimeSimulation&&)=delete;
+
+        /// run one simulation step
+        void step();
+
+        /// replace agents starting at first_agent, wrapping around at the end like SlimeSimulation::record_agent_upload
+        void spawn_agents(uint32_t first_agent,const std::vector<Agent> &agents);
+
+        Agent agent(uint32_t index)const{
+            return Agent{{agent_x[index],agent_y[index]},agent_angle[index],0.0f};
+        }
+        /// latest trail map, trail_width by trail_height
+        const Field2D& trail_map()const{
+            return trail_maps[current_trail_index];
+        }
+        size_t num_threads()const{
+            return thread_pool.num_threads();
+        }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <application/timeline.h>
+
+/// destroys resources once the gpu is done with them, instead of waiting for the device to become idle
+///
+/// defer() records the last submitted value of every timeline, i.e. retirement happens once all work that
+/// was submitted up to that point, on any queue, is complete. collect() runs the destructions that have
+/// retired without blocking, and should be called once per frame. destructions run in the order they were
+/// deferred.
+class DeletionQueue{
+    private:
+        struct Deletion{
+            /// value per timeline, in the order of timelines
+            std::vector<uint64_t> retirement_values;
+            std::function<void()> destroy;
+        };
+
+        std::vector<std::shared_ptr<Timeline>> timelines;
+        std::deque<Deletion> deletions;
+
+        bool retired(const Deletion &deletion)const;
+
+    public:
+        /// timelines of all queues that resources destroyed through this may be used on
+        DeletionQueue(std::vector<std::shared_ptr<Timeline>> timelines);
+        DeletionQueue(DeletionQueue&)=delete;
+        DeletionQueue(DeletionQueue&&)=delete;
+
+        /// runs all pending destructions, see flush
+        ~DeletionQueue();
+
+        /// run destroy once all work submitted so far is complete
+        void defer(std::function<void()> destroy);
+        /// run all destructions that have retired, returns the number of destructions still pending
+        size_t collect();
+        /// wait for all pending destructions to retire, and run them
+        void flush();
+};
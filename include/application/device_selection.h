@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+struct DeviceSelectionOptions{
+    /// also consider software implementations (e.g. lavapipe, swiftshader), which are skipped by default
+    bool allow_cpu=false;
+    /// use the device with this index (in vkEnumeratePhysicalDevices order) instead of the highest scoring one
+    std::optional<uint32_t> device_index;
+    /// use the first device whose name contains this string instead of the highest scoring one
+    std::string device_name;
+};
+
+/// everything device selection knows about a physical device, and which queue families it would use
+struct PhysicalDeviceCandidate{
+    VkPhysicalDevice physical_device=VK_NULL_HANDLE;
+    /// index in vkEnumeratePhysicalDevices order
+    uint32_t index=0;
+
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    std::vector<VkQueueFamilyProperties> queue_families;
+    std::vector<std::string> extensions;
+
+    /// queue family supporting graphics and compute, UINT32_MAX if none
+    uint32_t graphics_queue_family_index=UINT32_MAX;
+    /// queue family supporting presentation, same as graphics if possible, UINT32_MAX if none or not requested
+    uint32_t present_queue_family_index=UINT32_MAX;
+    /// queue family supporting compute but not graphics, UINT32_MAX if none
+    uint32_t dedicated_compute_queue_family_index=UINT32_MAX;
+    /// queue family supporting transfer but neither graphics nor compute, UINT32_MAX if none
+    uint32_t dedicated_transfer_queue_family_index=UINT32_MAX;
+
+    /// size of the largest device local memory heap
+    VkDeviceSize device_local_heap_size=0;
+
+    bool viable=false;
+    /// why the device is not viable, empty if it is
+    std::string rejection_reason;
+    /// higher is better, only meaningful if viable
+    int64_t score=0;
+
+    bool supports_extension(const char *extension_name)const;
+};
+
+/// query and score all physical devices of an instance
+///
+/// if surface is not VK_NULL_HANDLE, devices need a queue family that can present to it.
+/// devices that miss any of required_extensions are not viable.
+std::vector<PhysicalDeviceCandidate> enumerate_physical_device_candidates(
+    VkInstance instance,
+    VkSurfaceKHR surface,
+    const std::vector<const char*> &required_extensions,
+    const DeviceSelectionOptions &options
+);
+
+/// pick the device requested in options, or the viable device with the highest score
+/// throws VulkanError(NoViablePhysicalDeviceFound) if there is none, or the requested device is not viable
+const PhysicalDeviceCandidate& select_physical_device(
+    const std::vector<PhysicalDeviceCandidate> &candidates,
+    const DeviceSelectionOptions &options
+);
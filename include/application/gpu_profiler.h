@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+/// rolling gpu timings of one named scope, in milliseconds
+struct GpuScopeTimings{
+    std::string name;
+    /// number of samples the statistics are computed over, at most GpuProfiler::HISTORY_LENGTH
+    uint32_t num_samples=0;
+    double min_ms=0.0;
+    double avg_ms=0.0;
+    double p99_ms=0.0;
+    double last_ms=0.0;
+};
+
+/// measures gpu time of named scopes inside command buffers with timestamp queries
+///
+/// every frame slot owns a range of queries. begin_frame() reads back the results the slot wrote the last
+/// time it was used, which is complete because the slot's fence has been waited on, so reading back never
+/// stalls. results that are not available yet (e.g. the slot was never submitted) are skipped.
+///
+/// scopes with the same name in one frame are summed. scopes may be nested.
+class GpuProfiler{
+    public:
+        /// number of most recent frames the statistics of each scope are computed over
+        static constexpr uint32_t HISTORY_LENGTH=256;
+
+    private:
+        struct ScopeHistory{
+            std::vector<double> samples_ms;
+            /// next sample to overwrite once samples_ms is full
+            uint32_t next_sample=0;
+        };
+        struct FrameQueries{
+            /// scope name of each pair of queries written this frame
+            std::vector<std::string> scope_names;
+            bool recorded=false;
+        };
+
+        VkDevice device;
+        VkAllocationCallbacks *allocator;
+
+        VkQueryPool query_pool=VK_NULL_HANDLE;
+        uint32_t max_scopes_per_frame;
+        /// nanoseconds per timestamp tick
+        double timestamp_period;
+        /// timestamps wrap around after this many bits
+        uint32_t timestamp_valid_bits;
+
+        std::vector<FrameQueries> frames;
+        /// frame slot that scopes are currently recorded for
+        uint32_t current_frame=0;
+
+        std::map<std::string,ScopeHistory> history;
+
+        void read_back(uint32_t frame_index);
+
+    public:
+        GpuProfiler(
+            VkDevice device,
+            VkAllocationCallbacks *allocator,
+            VkPhysicalDevice physical_device,
+            uint32_t queue_family_index,
+            uint32_t num_frames,
+            uint32_t max_scopes_per_frame=64
+        );
+        GpuProfiler(GpuProfiler&)=delete;
+        GpuProfiler(GpuProfiler&&)=delete;
+
+        ~GpuProfiler();
+
+        /// false if the queue family does not support timestamps, all other methods are no-ops then
+        bool supported()const{
+            return query_pool!=VK_NULL_HANDLE;
+        }
+
+        /// read back the previous results of frame slot frame_index and reset its queries
+        /// must be called at the start of command_buffer, after the slot's fence has been waited on
+        void begin_frame(uint32_t frame_index,VkCommandBuffer command_buffer);
+
+        /// returns a token to pass to end_scope, scopes past max_scopes_per_frame are dropped
+        uint32_t begin_scope(VkCommandBuffer command_buffer,const char *name);
+        void end_scope(VkCommandBuffer command_buffer,uint32_t token);
+
+        /// statistics over the last HISTORY_LENGTH frames of every scope seen so far, sorted by name
+        std::vector<GpuScopeTimings> timings()const;
+        /// forget all samples, including those of frames not read back yet, e.g. to exclude a warmup from timings
+        /// must only be called while no frame slot is in flight
+        void reset_history();
+        void print_report()const;
+        /// print timings in the format of print_report, e.g. merged from the profilers of several queues
+        static void print_timings(const std::vector<GpuScopeTimings> &timings);
+};
+
+/// writes begin and end timestamps of a scope around its lifetime, does nothing if profiler is nullptr
+class GpuProfileScope{
+    private:
+        GpuProfiler *profiler;
+        VkCommandBuffer command_buffer;
+        uint32_t token=0;
+
+    public:
+        GpuProfileScope(GpuProfiler *profiler,VkCommandBuffer command_buffer,const char *name)
+        :profiler(profiler),command_buffer(command_buffer){
+            if(profiler){
+                token=profiler->begin_scope(command_buffer,name);
+            }
+        }
+        GpuProfileScope(GpuProfileScope&)=delete;
+        GpuProfileScope(GpuProfileScope&&)=delete;
+
+        ~GpuProfileScope(){
+            if(profiler){
+                profiler->end_scope(command_buffer,token);
+            }
+        }
+};
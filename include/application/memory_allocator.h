@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+/// a range of device memory handed out by DeviceMemoryAllocator
+struct MemoryAllocation{
+    VkDeviceMemory memory=VK_NULL_HANDLE;
+    VkDeviceSize offset=0;
+    VkDeviceSize size=0;
+    /// host address of offset if the memory is host visible, nullptr otherwise
+    void *mapped=nullptr;
+
+    uint32_t memory_type_index=0;
+    /// resource kind the allocation was made for, see DeviceMemoryAllocator
+    bool linear=true;
+    /// block index inside the pool, -1 for dedicated allocations
+    int32_t block_index=-1;
+    /// size class index for small allocations, -1 for allocations from the block free list
+    int32_t size_class_index=-1;
+    /// slab index inside the size class, only valid if size_class_index is not -1
+    int32_t slab_index=-1;
+};
+
+struct MemoryTypeStats{
+    uint32_t num_blocks=0;
+    VkDeviceSize block_bytes=0;
+    uint32_t num_dedicated_allocations=0;
+    VkDeviceSize dedicated_bytes=0;
+
+    /// allocations and bytes handed out from blocks (including size class slots)
+    uint32_t num_allocations=0;
+    VkDeviceSize allocated_bytes=0;
+
+    /// free bytes inside blocks, and the largest contiguous free range among them
+    VkDeviceSize free_bytes=0;
+    VkDeviceSize largest_free_range=0;
+};
+
+/// sub-allocates buffer and image memory from large blocks
+///
+/// every memory type has two pools, one for buffers and linear images and one for optimally tiled images,
+/// so that bufferImageGranularity never has to be considered inside a block.
+/// allocations up to MAX_SIZE_CLASS are served from slabs of equally sized slots, larger ones from a
+/// coalescing first fit free list, and allocations of at least half a block get their own VkDeviceMemory.
+/// host visible blocks are persistently mapped.
+///
+/// not thread safe.
+class DeviceMemoryAllocator{
+    public:
+        static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE=64ull<<20;
+        static constexpr VkDeviceSize MIN_SIZE_CLASS=256;
+        static constexpr VkDeviceSize MAX_SIZE_CLASS=64ull<<10;
+        /// memory for each slab of a size class
+        static constexpr VkDeviceSize SLAB_SIZE=1ull<<20;
+
+    private:
+        struct Block{
+            VkDeviceMemory memory=VK_NULL_HANDLE;
+            VkDeviceSize size=0;
+            void *mapped=nullptr;
+            /// offset -> size of free ranges, adjacent ranges are always merged
+            std::map<VkDeviceSize,VkDeviceSize> free_ranges;
+            uint32_t num_allocations=0;
+        };
+        struct Slab{
+            /// range of a block backing this slab, memory==VK_NULL_HANDLE if the slab was released
+            MemoryAllocation backing;
+            std::vector<uint32_t> free_slots;
+            uint32_t num_slots=0;
+        };
+        struct SizeClass{
+            VkDeviceSize slot_size=0;
+            std::vector<Slab> slabs;
+        };
+        struct Pool{
+            std::vector<std::unique_ptr<Block>> blocks;
+            std::vector<SizeClass> size_classes;
+        };
+
+        VkDevice device;
+        VkAllocationCallbacks *allocator;
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        uint32_t max_memory_allocation_count;
+        VkDeviceSize block_size[VK_MAX_MEMORY_TYPES];
+
+        /// [memory type][0 for non linear, 1 for linear]
+        Pool pools[VK_MAX_MEMORY_TYPES][2];
+
+        uint32_t num_device_memory_allocations=0;
+        std::vector<MemoryTypeStats> dedicated_stats;
+
+        /// returns VK_NULL_HANDLE if the memory type is out of memory, throws on other errors
+        VkDeviceMemory allocate_device_memory(uint32_t memory_type_index,VkDeviceSize size,void **mapped);
+        void free_device_memory(VkDeviceMemory memory);
+
+        bool allocate_from_block(Block &block,VkDeviceSize size,VkDeviceSize alignment,VkDeviceSize &offset);
+        void free_to_block(Block &block,VkDeviceSize offset,VkDeviceSize size);
+
+        /// these return an allocation with memory==VK_NULL_HANDLE if the memory type is out of memory
+        MemoryAllocation allocate_dedicated(uint32_t memory_type_index,bool linear,VkDeviceSize size);
+        MemoryAllocation allocate_from_pool(uint32_t memory_type_index,bool linear,VkDeviceSize size,VkDeviceSize alignment);
+        MemoryAllocation allocate_from_size_class(uint32_t memory_type_index,bool linear,int32_t size_class_index);
+
+    public:
+        DeviceMemoryAllocator(
+            VkDevice device,
+            VkAllocationCallbacks *allocator,
+            VkPhysicalDevice physical_device
+        );
+        DeviceMemoryAllocator(DeviceMemoryAllocator&)=delete;
+        DeviceMemoryAllocator(DeviceMemoryAllocator&&)=delete;
+
+        /// all allocations must have been freed before
+        ~DeviceMemoryAllocator();
+
+        /// allocate memory satisfying requirements from a memory type with all required properties
+        /// memory types that also have the preferred properties are used if available
+        /// linear is true for buffers and linearly tiled images, false for optimally tiled images
+        MemoryAllocation allocate(
+            const VkMemoryRequirements &requirements,
+            VkMemoryPropertyFlags required_properties,
+            VkMemoryPropertyFlags preferred_properties,
+            bool linear
+        );
+        void free(MemoryAllocation &allocation);
+
+        /// release blocks and slabs that contain no allocations
+        /// allocations are never moved, so this only returns memory that is entirely unused
+        void trim();
+
+        /// statistics for one memory type, summed over both pools
+        MemoryTypeStats stats(uint32_t memory_type_index)const;
+        void print_stats()const;
+};
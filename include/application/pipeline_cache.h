@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+struct PipelineCacheStats{
+    /// pipelines the driver reported as found in the cache
+    uint32_t num_hits=0;
+    /// pipelines the driver reported as compiled from scratch
+    uint32_t num_misses=0;
+    /// pipelines without creation feedback, i.e. VK_EXT_pipeline_creation_feedback is not available
+    uint32_t num_unknown=0;
+
+    double hit_milliseconds=0.0;
+    double miss_milliseconds=0.0;
+    double unknown_milliseconds=0.0;
+
+    /// time spent reading and validating the cache file
+    double load_milliseconds=0.0;
+    /// time spent retrieving cache data from the driver and writing the cache file
+    double save_milliseconds=0.0;
+};
+
+/// VkPipelineCache that is loaded from and saved to a file
+///
+/// the file name is derived from vendor id, device id, driver version and pipeline cache uuid, so that
+/// different devices and drivers never see each other's cache. the header is validated again on load,
+/// since the driver is allowed to crash on invalid cache data.
+class PipelineCache{
+    private:
+        VkDevice device;
+        VkAllocationCallbacks *allocator;
+        VkPhysicalDeviceProperties physical_device_properties;
+
+        /// chain VkPipelineCreationFeedbackCreateInfoEXT into pipeline creation
+        bool use_creation_feedback;
+
+        std::string filepath;
+
+        void record_creation(
+            const char *name,
+            double milliseconds,
+            const VkPipelineCreationFeedbackEXT &feedback
+        );
+
+    public:
+        VkPipelineCache handle=VK_NULL_HANDLE;
+        /// true if valid cache data was found on disk
+        bool loaded_from_disk=false;
+
+        PipelineCacheStats stats;
+
+        /// load the cache for this device from directory, starts empty if there is no valid cache file
+        /// use_creation_feedback requires VK_EXT_pipeline_creation_feedback to be enabled on device
+        PipelineCache(
+            VkDevice device,
+            VkAllocationCallbacks *allocator,
+            VkPhysicalDevice physical_device,
+            std::string directory,
+            bool use_creation_feedback
+        );
+        PipelineCache(PipelineCache&)=delete;
+        PipelineCache(PipelineCache&&)=delete;
+
+        ~PipelineCache();
+
+        /// write the current cache contents to disk, replacing the file atomically
+        void save();
+
+        /// vkCreateGraphicsPipelines through this cache, recording timing and cache hit/miss for name
+        VkResult create_graphics_pipeline(
+            const VkGraphicsPipelineCreateInfo &create_info,
+            VkPipeline &pipeline,
+            const char *name
+        );
+        /// vkCreateComputePipelines through this cache, recording timing and cache hit/miss for name
+        VkResult create_compute_pipeline(
+            const VkComputePipelineCreateInfo &create_info,
+            VkPipeline &pipeline,
+            const char *name
+        );
+
+        void print_stats()const;
+};
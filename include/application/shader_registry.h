@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+/// SPIR-V compiled into the binary, see embed_shaders in the Makefile
+struct EmbeddedShader{
+    const char *name;
+    const uint32_t *code;
+    size_t size;
+};
+
+/// owns all shader modules, each distinct SPIR-V blob is turned into a VkShaderModule only once
+///
+/// shaders are looked up by file name, first among the shaders embedded at build time, then on disk.
+/// files are memory mapped and handed to the driver directly, without an intermediate copy.
+class ShaderRegistry{
+    private:
+        VkDevice device;
+        VkAllocationCallbacks *allocator;
+
+        struct HashedModule{
+            /// copy of the SPIR-V code, to tell apart blobs with the same hash
+            std::vector<uint32_t> code;
+            VkShaderModule module;
+        };
+        /// fnv-1a hash of the SPIR-V code -> modules of all distinct blobs with that hash
+        std::unordered_multimap<uint64_t,HashedModule> modules_by_hash;
+        /// name as passed to get -> module
+        std::unordered_map<std::string,VkShaderModule> modules_by_name;
+
+        VkShaderModule create_module(const uint32_t *code,size_t size);
+
+    public:
+        ShaderRegistry(
+            VkDevice device,
+            VkAllocationCallbacks *allocator
+        ):device(device),allocator(allocator){}
+        ShaderRegistry(ShaderRegistry&)=delete;
+        ShaderRegistry(ShaderRegistry&&)=delete;
+
+        ~ShaderRegistry();
+
+        /// module for the SPIR-V file with this name, remains valid until clear or destruction of the registry
+        VkShaderModule get(const std::string &name);
+
+        /// destroy all modules, e.g. once all pipelines are created
+        void clear();
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <field2d.hpp>
+
+#include <application/vulkan_context.h>
+#include <application/staging_ring.h>
+
+class ComputePipeline;
+class GpuProfiler;
+
+struct SimulationParameters{
+    uint32_t num_agents=1<<20;
+    uint32_t trail_width=500;
+    uint32_t trail_height=500;
+    uint32_t seed=1;
+
+    /// distance in pixels an agent moves per step
+    float move_speed=1.0;
+    /// maximum rotation in radians per step
+    float turn_speed=0.4;
+    /// angle between forward sensor and left/right sensors, in radians
+    float sensor_angle=0.4;
+    /// distance in pixels of the sensors from the agent
+    float sensor_distance=9.0;
+    /// sensors sample a (2*sensor_size+1)^2 area
+    int32_t sensor_size=1;
+
+    /// trail amount deposited by each agent per step
+    float deposit=0.1;
+    /// trail amount removed per pixel per step
+    float decay=0.005;
+    /// blend factor between a pixel and its 3x3 neighbourhood per step
+    float diffuse=0.5;
+};
+
+/// must match struct Agent in slime_common.glsl
+struct Agent{
+    float position[2];
+    /// heading in radians
+    float angle;
+    float padding;
+};
+
+/// push constant block shared by all simulation kernels, must match slime_common.glsl
+/// the step index is not part of it but lives in a storage buffer on the gpu, so that the commands of a step
+/// do not change from one step to the next
+struct SimulationPushConstants{
+    uint32_t num_agents;
+    uint32_t trail_width;
+    uint32_t trail_height;
+    uint32_t seed;
+    float move_speed;
+    float turn_speed;
+    float sensor_angle;
+    float sensor_distance;
+    int32_t sensor_size;
+    float deposit;
+    float decay;
+    float diffuse;
+};
+
+/// slime mold agent simulation
+///
+/// agents live in a device local storage buffer, the trail map is ping-ponged between two storage images.
+/// each step runs the diffuse kernel (blur, decay) from the current into the other trail map and advances the
+/// step counter, then the agent kernel (sense, rotate, move) on the current trail map, which deposits into the other.
+/// a step only ever writes the other trail map, i.e. the one that was current two steps before, so drawing the
+/// current trail map may overlap with the next step.
+class SlimeSimulation{
+    private:
+        std::shared_ptr<VulkanContext> vulkan;
+
+        VkBuffer agent_buffer;
+        MemoryAllocation agent_buffer_memory;
+        /// single uint, the step_index of the next step as seen by the kernels
+        VkBuffer step_counter_buffer;
+        MemoryAllocation step_counter_buffer_memory;
+
+        VkImage trail_images[2];
+        MemoryAllocation trail_images_memory[2];
+        VkImageView trail_image_views[2];
+        VkSampler trail_sampler;
+
+        VkDescriptorPool descriptor_pool;
+        /// index i reads trail image i and writes trail image 1-i
+        VkDescriptorSet compute_descriptor_sets[2];
+        /// index i samples trail image i
+        VkDescriptorSet render_descriptor_sets[2];
+
+        std::shared_ptr<ComputePipeline> init_pipeline;
+        std::shared_ptr<ComputePipeline> agents_pipeline;
+        std::shared_ptr<ComputePipeline> diffuse_pipeline;
+
+        /// index of the trail image that holds the latest simulation result
+        uint32_t current_trail_index=0;
+
+        /// secondary command buffers of one step starting from trail image i, see prerecord_steps
+        VkCommandBuffer step_command_buffers[2]={VK_NULL_HANDLE,VK_NULL_HANDLE};
+
+        /// diffuse and agent kernels of one step from trail image trail_index, preceded by a barrier after earlier compute work
+        void record_step_dispatches(VkCommandBuffer command_buffer,GpuProfiler *profiler,uint32_t trail_index)const;
+
+        SimulationPushConstants push_constants()const;
+
+    public:
+        SimulationParameters parameters;
+        uint64_t step_index=0;
+
+        VkDescriptorSetLayout compute_descriptor_set_layout;
+        VkDescriptorSetLayout render_descriptor_set_layout;
+
+        /// create all simulation resources and initialise agents and trail map on the given queue
+        SlimeSimulation(
+            std::shared_ptr<VulkanContext> vulkan,
+            VkQueue queue,
+            uint32_t queue_family_index,
+            const SimulationParameters &parameters
+        );
+        SlimeSimulation(SlimeSimulation&)=delete;
+        SlimeSimulation(SlimeSimulation&&)=delete;
+
+        ~SlimeSimulation();
+
+        /// record the commands of a step from either trail image into two secondary command buffers, which
+        /// record_steps executes from then on instead of recording the kernels again. the commands only depend on
+        /// the trail image, since the step index is counted on the gpu. the command buffers are owned by the caller,
+        /// must belong to the queue family that record_steps is used on, and are recorded for simultaneous use
+        void prerecord_steps(const VkCommandBuffer command_buffers[2]);
+
+        /// record num_steps consecutive simulation steps into a command buffer, timed by profiler if it is not nullptr
+        /// the result is the same as recording one step at a time, with only compute barriers between steps.
+        /// once steps are prerecorded, only the steps as a whole are timed
+        /// on the graphics queue, the trail map written by the last step is visible to fragment shader reads afterwards.
+        /// on a compute only queue, rendering and the steps must instead be ordered with semaphores in both directions
+        void record_steps(VkCommandBuffer command_buffer,GpuProfiler *profiler,uint32_t num_steps,bool graphics_queue=true);
+
+        /// record a copy of agents from the staging ring into the agent buffer, starting at agent first_agent
+        /// agents past the end of the agent buffer wrap around to the start
+        void record_agent_upload(
+            VkCommandBuffer command_buffer,
+            StagingRing &staging_ring,
+            uint32_t first_agent,
+            const std::vector<Agent> &agents
+        );
+
+        /// record a copy of the latest trail map into the staging ring, callback receives a view of the
+        /// mapped staging memory (trail_width by trail_height, rows padded for simd) once the copy has completed
+        /// the trail map must not be written to until then, and the step that produced it must be complete
+        void record_trail_readback(
+            VkCommandBuffer command_buffer,
+            StagingRing &staging_ring,
+            std::function<void(const Field2D &trail_map)> callback
+        );
+
+        /// record a copy of trail_map (trail_width by trail_height) through the staging ring into the trail
+        /// image that is not current, which then becomes current, i.e. replaces a step with the result of
+        /// CpuSlimeSimulation. the trail image must not be in use by earlier frames until the copy is complete
+        void record_trail_upload(
+            VkCommandBuffer command_buffer,
+            StagingRing &staging_ring,
+            const Field2D &trail_map
+        );
+
+        /// index of the trail image that holds the latest simulation result
+        uint32_t trail_index()const{
+            return current_trail_index;
+        }
+        /// descriptor set (matching render_descriptor_set_layout) that samples trail image trail_index
+        VkDescriptorSet render_descriptor_set(uint32_t trail_index)const{
+            return render_descriptor_sets[trail_index];
+        }
+        /// descriptor set (matching render_descriptor_set_layout) that samples the latest trail map
+        VkDescriptorSet render_descriptor_set()const{
+            return render_descriptor_sets[current_trail_index];
+        }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <application/vulkan_context.h>
+
+/// part of the staging ring that may be written to (uploads) or copied into (readbacks)
+struct StagingRegion{
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void *mapped;
+};
+
+/// persistently mapped, host coherent buffer that is handed out in ring order for transfers
+///
+/// regions are allocated while recording transfer commands, then submitted() ties all regions (and
+/// completion callbacks) since the last submission to the fence of that submission. retire() releases
+/// regions whose fence is signaled, in submission order, and runs their callbacks, e.g. to consume
+/// readback data. allocate() waits for the oldest submission if the ring is full.
+///
+/// the owner of a fence must call retire(fence) before resetting it.
+class StagingRing{
+    private:
+        struct Submission{
+            VkFence fence;
+            /// first byte after the last region of this submission
+            VkDeviceSize end;
+            std::vector<std::function<void()>> completion_callbacks;
+        };
+
+        std::shared_ptr<VulkanContext> vulkan;
+
+        MemoryAllocation memory;
+
+        /// next byte to allocate from
+        VkDeviceSize head=0;
+        /// first byte still in use by a submission
+        VkDeviceSize tail=0;
+        /// regions allocated since the last submission
+        bool has_unsubmitted_regions=false;
+        std::vector<std::function<void()>> unsubmitted_callbacks;
+
+        std::deque<Submission> submissions;
+
+        bool is_empty()const{
+            return submissions.empty() && !has_unsubmitted_regions;
+        }
+        /// offset at which size bytes with alignment fit without overwriting live regions, or UINT64_MAX
+        VkDeviceSize find_space(VkDeviceSize size,VkDeviceSize alignment)const;
+
+    public:
+        VkBuffer buffer;
+        VkDeviceSize size;
+
+        StagingRing(
+            std::shared_ptr<VulkanContext> vulkan,
+            VkDeviceSize size
+        );
+        StagingRing(StagingRing&)=delete;
+        StagingRing(StagingRing&&)=delete;
+
+        ~StagingRing();
+
+        /// region of size bytes, throws if size exceeds the ring or the ring is full of unsubmitted regions
+        StagingRegion allocate(VkDeviceSize size,VkDeviceSize alignment=16);
+
+        /// run callback once the transfers recorded into the current (unsubmitted) regions are complete
+        void on_complete(std::function<void()> callback);
+
+        /// all regions allocated since the last call are in use until fence is signaled
+        void submitted(VkFence fence);
+
+        /// release regions of finished submissions and run their callbacks
+        /// if wait is set, waits for all submissions to finish
+        void retire(bool wait=false);
+        /// release regions up to and including the submission using fence, waiting for them as necessary
+        void retire(VkFence fence);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+/// timeline semaphore of one queue, signaled with a monotonically increasing value by every submission to it
+///
+/// requires VK_KHR_timeline_semaphore. next() hands out the value for the next submission, which must then be
+/// attached to that submission (VkTimelineSemaphoreSubmitInfo). work is complete once completed() reaches its value.
+class Timeline{
+    private:
+        VkDevice device;
+        VkAllocationCallbacks *allocator;
+
+        PFN_vkGetSemaphoreCounterValueKHR vk_get_semaphore_counter_value;
+        PFN_vkWaitSemaphoresKHR vk_wait_semaphores;
+
+        /// value signaled by the most recent submission
+        uint64_t submitted_value;
+
+    public:
+        VkSemaphore handle;
+
+        Timeline(
+            VkDevice device,
+            VkAllocationCallbacks *allocator,
+            uint64_t initial_value=0
+        );
+        Timeline(Timeline&)=delete;
+        Timeline(Timeline&&)=delete;
+
+        ~Timeline();
+
+        /// value for the next submission, every call must be followed by a submission that signals it
+        uint64_t next(){
+            return ++submitted_value;
+        }
+        /// value of the most recent submission, all work submitted so far is complete once it is reached
+        uint64_t last_submitted()const{
+            return submitted_value;
+        }
+
+        /// value the semaphore currently has on the device, does not block
+        uint64_t completed()const;
+        bool reached(uint64_t value)const{
+            return completed()>=value;
+        }
+        /// block until value is reached, returns false if timeout_ns passed first
+        bool wait_until(uint64_t value,uint64_t timeout_ns=UINT64_MAX)const;
+        /// block until all work submitted so far is complete
+        void wait_idle()const{
+            wait_until(submitted_value);
+        }
+};
@@ -1,9 +1,19 @@
 #pragma once
 
 #include "vulkan/vulkan_core.h"
+#include <functional>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 #include <vulkan/vulkan.h>
 
+#include <application/memory_allocator.h>
+
+class DeletionQueue;
+class GpuProfiler;
+class PipelineCache;
+class ShaderRegistry;
+
 class VulkanContext{
     public:
         VkAllocationCallbacks *allocator=nullptr;
@@ -11,13 +21,37 @@ class VulkanContext{
         VkPhysicalDevice physical_device;
         VkDevice device=VK_NULL_HANDLE;
 
+        VkPhysicalDeviceMemoryProperties memory_properties{};
+
+        /// all buffer and image memory is sub-allocated from this, only set if there is a device
+        std::shared_ptr<DeviceMemoryAllocator> memory_allocator;
+
+        /// queue families that access buffers and images, if there is more than one all resources are created
+        /// with concurrent sharing, so that they never need queue family ownership transfers
+        std::vector<uint32_t> resource_queue_family_indices;
+
+        /// cache used for all pipeline creation, pipelines are created without cache if not set
+        std::shared_ptr<PipelineCache> pipeline_cache;
+        /// source of all shader modules
+        std::shared_ptr<ShaderRegistry> shader_registry;
+        /// timestamps of work on the graphics queue, profiling is disabled if not set
+        std::shared_ptr<GpuProfiler> gpu_profiler;
+        /// resources that submitted work may still use are destroyed through this, only set if the device
+        /// supports timeline semaphores, see destroy_when_unused
+        std::shared_ptr<DeletionQueue> deletion_queue;
+
         VulkanContext(
             VkAllocationCallbacks *vk_allocator,
             VkInstance vk_instance,
             VkPhysicalDevice vk_physical_device,
             VkDevice vk_device
         ):allocator{vk_allocator},instance{vk_instance},physical_device{vk_physical_device},device{vk_device}{
-            
+            if(physical_device!=VK_NULL_HANDLE){
+                vkGetPhysicalDeviceMemoryProperties(physical_device,&memory_properties);
+            }
+            if(device!=VK_NULL_HANDLE){
+                memory_allocator=std::make_shared<DeviceMemoryAllocator>(device,allocator,physical_device);
+            }
         }
         VulkanContext(VulkanContext&)=delete;
         VulkanContext(VulkanContext&&)=delete;
@@ -27,6 +61,13 @@ class VulkanContext{
             if(device!=VK_NULL_HANDLE){
                 deviceWaitIdle();
 
+                // pending destructions may still need any of the below
+                deletion_queue.reset();
+                pipeline_cache.reset();
+                shader_registry.reset();
+                gpu_profiler.reset();
+                memory_allocator.reset();
+
                 vkDestroyDevice(
                     device,
                     allocator
@@ -45,6 +86,58 @@ class VulkanContext{
                 vkDeviceWaitIdle(device);
             }
         }
+
+        /// return index of first memory type allowed by type_bits that has all requested properties
+        uint32_t find_memory_type(
+            uint32_t type_bits,
+            VkMemoryPropertyFlags properties
+        )const{
+            for(uint32_t i=0;i<memory_properties.memoryTypeCount;i++){
+                if((type_bits&(1u<<i)) && (memory_properties.memoryTypes[i].propertyFlags&properties)==properties){
+                    return i;
+                }
+            }
+            throw std::runtime_error("no suitable memory type found");
+        }
+
+        /// sharing mode for new buffers and images, see resource_queue_family_indices
+        VkSharingMode sharing_mode()const;
+
+        /// run destroy once all work submitted so far is complete, through deletion_queue if there is one,
+        /// otherwise immediately, i.e. the caller must have waited for the device to become idle
+        /// destroy must not hold on to this context, which would keep it alive
+        void destroy_when_unused(std::function<void()> destroy)const;
+
+        /// create a buffer backed by memory from memory_allocator
+        /// preferred_memory_properties are used if a memory type with them exists, e.g. HOST_CACHED for readback
+        void create_buffer(
+            VkDeviceSize size,
+            VkBufferUsageFlags usage,
+            VkMemoryPropertyFlags memory_properties,
+            VkBuffer &buffer,
+            MemoryAllocation &buffer_memory,
+            VkMemoryPropertyFlags preferred_memory_properties=0
+        )const;
+        void destroy_buffer(
+            VkBuffer buffer,
+            MemoryAllocation &buffer_memory
+        )const;
+
+        /// create a 2d single mip level image backed by device local memory from memory_allocator, and a view for it
+        void create_image(
+            uint32_t width,
+            uint32_t height,
+            VkFormat format,
+            VkImageUsageFlags usage,
+            VkImage &image,
+            MemoryAllocation &image_memory,
+            VkImageView &image_view
+        )const;
+        void destroy_image(
+            VkImage image,
+            MemoryAllocation &image_memory,
+            VkImageView image_view
+        )const;
 };
 
 class Semaphore{
@@ -65,3 +158,30 @@ class Semaphore{
             vkDestroySemaphore(device,handle,allocator);
         }
 };
+
+class Fence{
+    VkDevice device;
+    VkAllocationCallbacks *allocator;
+    public:
+        VkFence handle;
+        Fence(
+            VkDevice device,
+            VkAllocationCallbacks *allocator,
+            VkFence handle
+        ){
+            this->device=device;
+            this->allocator=allocator;
+            this->handle=handle;
+        }
+        ~Fence(){
+            vkDestroyFence(device,handle,allocator);
+        }
+
+        /// block until the fence is signaled
+        void wait()const{
+            vkWaitForFences(device,1,&handle,VK_TRUE,UINT64_MAX);
+        }
+        void reset()const{
+            vkResetFences(device,1,&handle);
+        }
+};
@@ -26,6 +26,23 @@ enum class VulkanErrorContext{
     CreateCommandPool,
     AllocateCommandBuffers,
     CreateGraphicsPipelines,
+    CreateComputePipelines,
+    CreateImage,
+    CreateImageView,
+    BindImageMemory,
+    CreateSampler,
+    QueueSubmit,
+    CreateFence,
+    CreateSemaphore,
+    QueuePresent,
+    CreateFramebuffer,
+    CreatePipelineCache,
+    GetPipelineCacheData,
+    MapMemory,
+    CreateQueryPool,
+    GetQueryPoolResults,
+    GetSemaphoreCounterValue,
+    WaitSemaphores,
 };
 class VulkanError{
     private:
@@ -3,8 +3,12 @@
 #include <variant>
 #include <string>
 #include <vector>
+#include <array>
+#include <span>
 #include <memory>
 #include <iostream>
+#include <chrono>
+#include <optional>
 
 #ifdef VK_USE_PLATFORM_XCB_KHR
     #include <xcb/xcb.h>
@@ -17,6 +21,19 @@
 #include <application/vulkan_context.h>
 #include <application/vulkan_error.h>
 
+/// how the swapchain trades latency, throughput and power, i.e. its present mode and number of images
+/// present modes the surface does not support fall back to the next one listed, and finally to FIFO, which is always supported
+enum class SwapchainPolicy{
+    /// FIFO with the minimum number of images, rendering is limited to the display refresh rate
+    PowerSaving,
+    /// MAILBOX (or IMMEDIATE) with enough images that acquiring never waits, the newest frame is shown at the next vertical blank
+    LowLatency,
+    /// IMMEDIATE (or MAILBOX) with one image more than the minimum, so that rendering waits on presentation as little as possible
+    MaxThroughput,
+};
+
+/// (part of) the window contents need to be drawn again
+struct WindowExposeEvent{};
 struct WindowMoveEvent{
     int new_x;
     int new_y;
@@ -73,7 +90,8 @@ typedef std::variant<
     PointerEnteredWindow,
     PointerExitedWindow,
     WindowResizeEvent,
-    WindowMoveEvent
+    WindowMoveEvent,
+    WindowExposeEvent
 > WindowEventVariant;
 class WindowEvent{
     private:
@@ -81,6 +99,7 @@ class WindowEvent{
     public:
         WindowEventVariant event_variant;
 
+        WindowEvent()=default;
         WindowEvent(const WindowEventVariant &event_variant){
             this->event_variant=event_variant;
         }
@@ -88,6 +107,53 @@ class WindowEvent{
         std::string string()const;
 };
 
+/// fixed capacity storage for the events of one Window::get_latest_events call, reused for every call
+/// so that handling input does not allocate
+class WindowEventBuffer{
+    public:
+        static constexpr size_t CAPACITY=256;
+
+    private:
+        std::array<WindowEvent,CAPACITY> events;
+        size_t num_events=0;
+
+    public:
+        /// merge consecutive PointerMoved events into the last one, and sum up consecutive ScrollEvents
+        bool coalesce=true;
+
+        /// drop all events, all previously returned spans are invalidated
+        void clear(){
+            num_events=0;
+        }
+        /// number of events that can still be pushed
+        size_t available()const{
+            return CAPACITY-num_events;
+        }
+        /// requires available()>0, unless the event can be coalesced
+        void push(const WindowEventVariant &event){
+            if(coalesce && num_events>0){
+                auto &last=events[num_events-1].event_variant;
+                if(auto *pointer_moved=std::get_if<PointerMoved>(&last)){
+                    if(auto *next_pointer_moved=std::get_if<PointerMoved>(&event)){
+                        *pointer_moved=*next_pointer_moved;
+                        return;
+                    }
+                }else if(auto *scroll=std::get_if<ScrollEvent>(&last)){
+                    if(auto *next_scroll=std::get_if<ScrollEvent>(&event)){
+                        scroll->scroll_x+=next_scroll->scroll_x;
+                        scroll->scroll_y+=next_scroll->scroll_y;
+                        return;
+                    }
+                }
+            }
+            events[num_events].event_variant=event;
+            num_events++;
+        }
+        std::span<const WindowEvent> span()const{
+            return {events.data(),num_events};
+        }
+};
+
 
 class Window{
     public:
@@ -99,6 +165,8 @@ class Window{
     private:
         #ifdef VK_USE_PLATFORM_XCB_KHR
             xcb_connection_t *xcb_connection;
+            /// event taken from the xcb queue by wait_for_events, returned first by get_latest_events
+            xcb_generic_event_t *pending_event=nullptr;
         #endif
     public:
         #ifdef VK_USE_PLATFORM_XCB_KHR
@@ -112,6 +180,9 @@ class Window{
         std::shared_ptr<VulkanContext> vulkan;
 
     public:
+        /// storage of get_latest_events, set event_buffer.coalesce to control merging of pointer motion and scroll events
+        WindowEventBuffer event_buffer;
+
         VkSurfaceKHR vk_surface=VK_NULL_HANDLE;
         
         VkSwapchainKHR vk_swapchain=VK_NULL_HANDLE;
@@ -120,6 +191,9 @@ class Window{
         std::vector<VkImageView> vk_swapchain_image_views;
 
         VkSurfaceFormatKHR vk_swapchain_surface_format;
+        VkPresentModeKHR vk_swapchain_present_mode;
+
+        SwapchainPolicy swapchain_policy;
     
     private:
         bool is_non_temp_window()const{
@@ -142,6 +216,7 @@ class Window{
             std::shared_ptr<VulkanContext> vulkan,
             int width,
             int height,
+            SwapchainPolicy swapchain_policy=SwapchainPolicy::PowerSaving,
             int x=0,
             int y=0,
             int screen_index=0
@@ -157,17 +232,19 @@ class Window{
         void create_framebuffers(
             VkRenderPass render_pass
         );
+        /// create the swapchain according to swapchain_policy, replacing the current one
+        /// prefers 8 bit unorm formats, which take the rendered values as they are, like the offscreen image
         void create_swapchain();
 
-        void vulkan_resize(VkRenderPass render_pass){
-            destroy_framebuffers();
-            destroy_image_views();
-            create_swapchain();
-            create_framebuffers(render_pass);
-            vulkan->deviceWaitIdle();
-        }
+        /// recreate swapchain and framebuffers, the old ones are destroyed once frames in flight are done with them
+        void vulkan_resize(VkRenderPass render_pass);
 
-        std::vector<WindowEvent> get_latest_events();
+        /// events received since the last call, in order, up to WindowEventBuffer::CAPACITY (the rest are returned by the next call)
+        /// the span is valid until the next call
+        std::span<const WindowEvent> get_latest_events();
+        /// block until window events are available or deadline has passed, without deadline only return on events
+        /// returns whether events may be available, get_latest_events returns them
+        bool wait_for_events(std::optional<std::chrono::steady_clock::time_point> deadline);
 
         void destroy_image_views(){
             for(auto image_view:vk_swapchain_image_views){
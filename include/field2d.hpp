@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <matrix.hpp>
+#include <matrix_allocator.hpp>
+#include <matrix_reduce.hpp>
+#include <matrix_simd.hpp>
+#include <thread_pool.hpp>
+
+/// dense 2D float field with sizes chosen at runtime, e.g. a trail map
+///
+/// storage is row-major, with rows pitch() elements apart (pitch()>=width()). a field either owns its
+/// memory, from the current MatrixAllocator with every row aligned to MatrixAllocator::ALIGNMENT, or is a
+/// view of memory owned by someone else (a mapped vulkan buffer, a Matrix), which is never copied.
+/// element-wise operations and reductions use the same kernels as Matrix. reductions work on whole rows,
+/// so their results only depend on the width and height, not on the pitch or the number of threads.
+class Field2D{
+    private:
+        float* values=nullptr;
+        size_t field_width=0;
+        size_t field_height=0;
+        size_t row_pitch=0;
+        /// nullptr for views
+        MatrixAllocator* allocator=nullptr;
+
+        static constexpr size_t ROW_ALIGNMENT=MatrixAllocator::ALIGNMENT/sizeof(float);
+
+        void release(){
+            if(allocator!=nullptr && values!=nullptr){
+                allocator->deallocate(values,row_pitch*field_height*sizeof(float));
+            }
+            values=nullptr;
+            allocator=nullptr;
+        }
+
+        void allocate(size_t width,size_t height){
+            field_width=width;
+            field_height=height;
+            row_pitch=(width+ROW_ALIGNMENT-1)/ROW_ALIGNMENT*ROW_ALIGNMENT;
+            if(row_pitch*height>0){
+                allocator=&MatrixAllocator::current();
+                values=(float*)allocator->allocate(row_pitch*height*sizeof(float));
+            }
+        }
+
+        /// rows per reduction chunk, about matrix_reduce::CHUNK elements
+        size_t rows_per_chunk()const{
+            return field_width>=matrix_reduce::CHUNK?1:matrix_reduce::CHUNK/field_width;
+        }
+
+        /// reduce_row(row) for every row, combined sequentially within a chunk and as a tree across chunks
+        template<class T,class ReduceRow,class Combine>
+        T reduce_rows(ReduceRow reduce_row,Combine combine,ThreadPool &thread_pool)const{
+            return matrix_reduce::reduce<T>(field_height,[&](size_t begin,size_t count){
+                T ret=reduce_row(begin);
+                for(size_t y=begin+1;y<begin+count;y++){
+                    ret=combine(ret,reduce_row(y));
+                }
+                return ret;
+            },combine,thread_pool,rows_per_chunk());
+        }
+
+    public:
+        /// empty field
+        Field2D()=default;
+        /// owning field, values are not initialised
+        Field2D(size_t width,size_t height){
+            allocate(width,height);
+        }
+        /// owning field with every value set to value
+        Field2D(size_t width,size_t height,float value):Field2D(width,height){
+            fill(value);
+        }
+        /// owning copy, also of views
+        Field2D(const Field2D& other):Field2D(other.field_width,other.field_height){
+            copy_rows(other);
+        }
+        Field2D(Field2D&& other)noexcept{
+            swap(other);
+        }
+        ~Field2D(){
+            release();
+        }
+
+        /// copies values, fields of the same size (including views) keep their memory,
+        /// owning fields are resized otherwise
+        Field2D& operator=(const Field2D& other){
+            if(this!=&other){
+                if(field_width!=other.field_width || field_height!=other.field_height){
+                    resize(other.field_width,other.field_height);
+                }
+                copy_rows(other);
+            }
+            return *this;
+        }
+        Field2D& operator=(Field2D&& other)noexcept{
+            swap(other);
+            return *this;
+        }
+        void swap(Field2D& other)noexcept{
+            std::swap(values,other.values);
+            std::swap(field_width,other.field_width);
+            std::swap(field_height,other.field_height);
+            std::swap(row_pitch,other.row_pitch);
+            std::swap(allocator,other.allocator);
+        }
+
+        /// view of memory owned by someone else, which must outlive the view
+        /// pitch is the distance between rows in elements, 0 means width
+        static Field2D view(float* data,size_t width,size_t height,size_t pitch=0){
+            assert(pitch==0 || pitch>=width);
+            Field2D ret;
+            ret.values=data;
+            ret.field_width=width;
+            ret.field_height=height;
+            ret.row_pitch=pitch==0?width:pitch;
+            return ret;
+        }
+        /// view of a matrix, rows of the field are columns of the (column-major) matrix
+        template<index_t ROWS,index_t COLS>
+        static Field2D view(Matrix<ROWS,COLS> &matrix){
+            return view(matrix.data(),ROWS,COLS);
+        }
+
+        /// new size for an owning field, values are not preserved (or initialised)
+        void resize(size_t width,size_t height){
+            assert(owns_memory() || values==nullptr);
+            if(width==field_width && height==field_height){
+                return;
+            }
+            release();
+            allocate(width,height);
+        }
+
+        size_t width()const{
+            return field_width;
+        }
+        size_t height()const{
+            return field_height;
+        }
+        /// distance between rows in elements
+        size_t pitch()const{
+            return row_pitch;
+        }
+        bool owns_memory()const{
+            return allocator!=nullptr;
+        }
+        /// rows directly follow each other
+        bool contiguous()const{
+            return row_pitch==field_width;
+        }
+
+        float* data(){
+            return values;
+        }
+        const float* data()const{
+            return values;
+        }
+        float* row(size_t y){
+            return values+y*row_pitch;
+        }
+        const float* row(size_t y)const{
+            return values+y*row_pitch;
+        }
+        float& operator()(size_t x,size_t y){
+            return values[y*row_pitch+x];
+        }
+        float operator()(size_t x,size_t y)const{
+            return values[y*row_pitch+x];
+        }
+
+        /// copy values from a field of the same size
+        void copy_rows(const Field2D& other){
+            assert(other.field_width==field_width && other.field_height==field_height);
+            if(contiguous() && other.contiguous()){
+                std::memcpy(values,other.values,field_width*field_height*sizeof(float));
+                return;
+            }
+            for(size_t y=0;y<field_height;y++){
+                std::memcpy(row(y),other.row(y),field_width*sizeof(float));
+            }
+        }
+
+        void fill(float value){
+            if(contiguous()){
+                matrix_simd::fill(values,value,field_width*field_height);
+                return;
+            }
+            for(size_t y=0;y<field_height;y++){
+                matrix_simd::fill(row(y),value,field_width);
+            }
+        }
+        /// multiply every value by value
+        void scale(float value){
+            if(contiguous()){
+                matrix_simd::scale(values,values,value,field_width*field_height);
+                return;
+            }
+            for(size_t y=0;y<field_height;y++){
+                matrix_simd::scale(row(y),row(y),value,field_width);
+            }
+        }
+        /// add a field of the same size
+        void add(const Field2D& other){
+            assert(other.field_width==field_width && other.field_height==field_height);
+            if(contiguous() && other.contiguous()){
+                matrix_simd::add(values,values,other.values,field_width*field_height);
+                return;
+            }
+            for(size_t y=0;y<field_height;y++){
+                matrix_simd::add(row(y),row(y),other.row(y),field_width);
+            }
+        }
+
+        /// reductions run on the given pool, the global one by default, and must not be called on empty fields
+        double sum(ThreadPool &thread_pool=ThreadPool::global())const{
+            return reduce_rows<double>([this](size_t y){
+                return matrix_simd::sum(row(y),field_width);
+            },[](double a,double b){
+                return a+b;
+            },thread_pool);
+        }
+        double mean(ThreadPool &thread_pool=ThreadPool::global())const{
+            return sum(thread_pool)/(field_width*field_height);
+        }
+        /// population variance
+        double variance(ThreadPool &thread_pool=ThreadPool::global())const{
+            double mean_value=mean(thread_pool);
+            double squared_deviations=reduce_rows<double>([this,mean_value](size_t y){
+                return matrix_simd::sum_squared_deviations(row(y),field_width,mean_value);
+            },[](double a,double b){
+                return a+b;
+            },thread_pool);
+            return squared_deviations/(field_width*field_height);
+        }
+        matrix_reduce::MinMax min_max(ThreadPool &thread_pool=ThreadPool::global())const{
+            return reduce_rows<matrix_reduce::MinMax>([this](size_t y){
+                matrix_reduce::MinMax ret;
+                matrix_simd::min_max(row(y),field_width,ret.min,ret.max);
+                return ret;
+            },matrix_reduce::MinMax::combine,thread_pool);
+        }
+        /// value counts in num_bins equal bins over [low,high), out of range values land in the first or last bin
+        std::vector<uint64_t> histogram(size_t num_bins,float low,float high,ThreadPool &thread_pool=ThreadPool::global())const{
+            matrix_reduce::HistogramBins histogram_bins(num_bins,low,high);
+            return matrix_reduce::reduce<std::vector<uint64_t>>(field_height,[&](size_t begin,size_t count){
+                std::vector<uint64_t> bins(num_bins,0);
+                for(size_t y=begin;y<begin+count;y++){
+                    histogram_bins.count(bins,row(y),field_width);
+                }
+                return bins;
+            },matrix_reduce::HistogramBins::combine,thread_pool,rows_per_chunk());
+        }
+};
@@ -5,6 +5,16 @@
 #include <string>
 #include <functional>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <matrix_allocator.hpp>
+#include <matrix_simd.hpp>
+#include <matrix_gemm.hpp>
+#include <matrix_reduce.hpp>
+#include <matrix_expression.hpp>
 
 typedef size_t index_t;
 
@@ -30,25 +40,44 @@ class MatrixMemory<
     false
 >{
     private:
+        static constexpr size_t BYTES=sizeof(float)*ROWS*COLS;
+
         float* values;
+        /// where values came from, the current allocator may have changed since
+        MatrixAllocator* allocator;
 
     public:
-        MatrixMemory(){
-            values=(float*)malloc(sizeof(float)*ROWS*COLS);
+        MatrixMemory():allocator(&MatrixAllocator::current()){
+            values=(float*)allocator->allocate(BYTES);
         }
-        MatrixMemory(const MatrixMemory&):MatrixMemory(){}
-        MatrixMemory(MatrixMemory&& other){
-            values=other.values;
-            other.values=nullptr;
+        MatrixMemory(const MatrixMemory& other):MatrixMemory(){
+            std::memcpy(values,other.values,BYTES);
         }
-        void operator=(MatrixMemory& other){
-            free(values);
-            values=other.values;
+        /// other is left without storage
+        MatrixMemory(MatrixMemory&& other)noexcept:values(other.values),allocator(other.allocator){
             other.values=nullptr;
         }
+        MatrixMemory& operator=(const MatrixMemory& other){
+            if(this!=&other){
+                if(values==nullptr){
+                    // moved from
+                    allocator=&MatrixAllocator::current();
+                    values=(float*)allocator->allocate(BYTES);
+                }
+                std::memcpy(values,other.values,BYTES);
+            }
+            return *this;
+        }
+        /// swaps storage, so the old one is freed together with other
+        MatrixMemory& operator=(MatrixMemory&& other)noexcept{
+            std::swap(values,other.values);
+            std::swap(allocator,other.allocator);
+            return *this;
+        }
         ~MatrixMemory(){
-            if(values!=nullptr)
-                free(values);
+            if(values!=nullptr){
+                allocator->deallocate(values,BYTES);
+            }
         }
 
         /// return nth column
@@ -58,6 +87,14 @@ class MatrixMemory<
         float* operator[](index_t index){
             return ((float*)(&values[index*ROWS]));
         }
+
+        /// all values, column after column
+        float* data(){
+            return values;
+        }
+        const float* data()const{
+            return values;
+        }
 };
 
 template<
@@ -77,38 +114,86 @@ class MatrixMemory<
         float* operator[](index_t index)const{
             return (float*)(&(values[index*ROWS]));
         }
+
+        /// all values, column after column
+        float* data(){
+            return values;
+        }
+        const float* data()const{
+            return values;
+        }
 };
 
 
 /// matrix data layout is column-major
+///
+/// element-wise arithmetic (+, -, scalar * and /, hadamard) builds lazy expressions, see matrix_expression.hpp,
+/// which are evaluated in a single pass when assigned to a Matrix or reduced with sum()
 template<
     index_t ROWS,
     index_t COLS
 >
 class Matrix{
     public:
-        MatrixMemory<COLS,ROWS> values;
+        MatrixMemory<ROWS,COLS> values;
+
+        static constexpr index_t rows=ROWS;
+        static constexpr index_t cols=COLS;
 
     public:
         Matrix(){
             // Matrix::values will be default constructed, which is fine
         }
+        /// data is column-major, like the matrix itself
         Matrix(const float (&data)[ROWS*COLS]){
-            foreach([&](auto c,auto r){
-                values[c][r]=data[c*ROWS+r];
-            });
+            std::memcpy(this->data(),data,sizeof(float)*ROWS*COLS);
         }
         Matrix(const Matrix& m):Matrix(){
-            foreach([&](auto col,auto row){
-                values[col][row]=m[col][row];
-            });
+            std::memcpy(data(),m.data(),sizeof(float)*ROWS*COLS);
+        }
+        Matrix(Matrix&& m)=default;
+
+        /// evaluate an expression of the same shape
+        template<class E> requires MatrixOperand<E> && (E::rows==ROWS && E::cols==COLS)
+        Matrix(const E& expression):Matrix(){
+            expression.evaluate_into(data());
+        }
+
+        Matrix& operator=(const Matrix& m){
+            if(this!=&m){
+                values=m.values;
+            }
+            return *this;
+        }
+        Matrix& operator=(Matrix&& m){
+            // heap backed memory takes over the other matrix's allocation, inline memory is copied
+            if(this!=&m){
+                values=std::move(m.values);
+            }
+            return *this;
+        }
+        /// evaluate an expression of the same shape, which may reference this matrix
+        template<class E> requires MatrixOperand<E> && (!is_matrix<E>::value) && (E::rows==ROWS && E::cols==COLS)
+        Matrix& operator=(const E& expression){
+            expression.evaluate_into(data());
+            return *this;
         }
 
         /// initialise each value of the matrix so some value
         Matrix(float v):Matrix(){
-            foreach([&](auto col,auto row){
-                values[col][row]=v;
-            });
+            matrix_simd::fill(data(),v,ROWS*COLS);
+        }
+
+        /// all values, column after column
+        float* data(){
+            return values.data();
+        }
+        const float* data()const{
+            return values.data();
+        }
+        /// value at index of data(), makes Matrix a leaf of expressions
+        float eval(index_t index)const{
+            return data()[index];
         }
 
         /// first arg is row
@@ -153,42 +238,55 @@ class Matrix{
         }
 
         // sum value type is double to avoid early float precsion issues
+        // reductions run on the global thread pool and give the same result for any number of threads
         double sum()const{
-            double s=0.0;
-            foreach([&](auto r,auto c){
-                s+=values[r][c];
-            });
-            return s;
+            return matrix_reduce::sum(data(),ROWS*COLS,ThreadPool::global());
         }
-
-        Matrix<ROWS,COLS> operator*(float v)const{
-            auto ret = Matrix<ROWS, COLS>();
-            foreach([&](auto r,auto c){
-                ret[r][c] = values[r][c] * v;
-            });
-            return ret;
+        double mean()const{
+            return sum()/(ROWS*COLS);
+        }
+        /// population variance
+        double variance()const{
+            return matrix_reduce::variance(data(),ROWS*COLS,ThreadPool::global());
+        }
+        float min()const{
+            return matrix_reduce::min_max(data(),ROWS*COLS,ThreadPool::global()).min;
+        }
+        float max()const{
+            return matrix_reduce::min_max(data(),ROWS*COLS,ThreadPool::global()).max;
+        }
+        /// value counts in num_bins equal bins over [low,high), out of range values land in the first or last bin
+        std::vector<uint64_t> histogram(size_t num_bins,float low,float high)const{
+            return matrix_reduce::histogram(data(),ROWS*COLS,num_bins,low,high,ThreadPool::global());
         }
 
         template<index_t R_COLS>
-        Matrix<R_COLS,ROWS> operator*(const Matrix<COLS,R_COLS> &right)const{
-            auto ret = Matrix<R_COLS,ROWS>{};
-            for(index_t r=0;r<R_COLS;r++){
-                for(index_t c=0;c<ROWS;c++){
-                    float e=0.0;
+        Matrix<ROWS,R_COLS> operator*(const Matrix<COLS,R_COLS> &right)const{
+            auto ret = Matrix<ROWS,R_COLS>{};
+            if constexpr((ROWS<256 && COLS<256) || (COLS<256 && R_COLS<256)){
+                // small enough that blocking and threading would cost more than they save
+                // loop order keeps the innermost accesses contiguous in column-major storage
+                matrix_simd::fill(ret.data(),0.0f,ROWS*R_COLS);
+                for(index_t c=0;c<R_COLS;c++){
+                    float* ret_column=ret[c];
                     for(index_t i=0;i<COLS;i++){
-                        e+=values[c][i]*right[i][r];
+                        const float* column=values[i];
+                        float b=right[c][i];
+                        for(index_t r=0;r<ROWS;r++){
+                            ret_column[r]+=column[r]*b;
+                        }
                     }
-                    ret[r][c]=e;
                 }
+            }else{
+                matrix_gemm::gemm(ret.data(),data(),right.data(),ROWS,R_COLS,COLS,ThreadPool::global());
             }
             return ret;
         }
 
         Matrix<COLS,ROWS> transposed()const{
             Matrix<COLS,ROWS> ret;
-            foreach([&](auto r,auto c){
-                ret[c][r] = values[r][c];
-            });
+            // columns of this are the rows of ret
+            matrix_simd::transpose(ret.data(),data(),COLS,ROWS);
             return ret;
         }
 
@@ -211,6 +309,10 @@ class Matrix{
         }
 };
 
-class Vec3:public Matrix<3,1>{};
-class Vec4:public Matrix<4,1>{};
-class Mat4:public Matrix<4,4>{};
+/// matrix product with an unevaluated left operand, which is evaluated first
+template<class E,index_t R_COLS> requires MatrixOperand<E> && (!is_matrix<E>::value)
+Matrix<E::rows,R_COLS> operator*(const E& left,const Matrix<E::cols,R_COLS> &right){
+    return Matrix<E::rows,E::cols>(left)*right;
+}
+
+#include <small_matrix.hpp>
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+struct MatrixAllocationCounters{
+    /// calls to allocate and deallocate
+    uint64_t num_allocations=0;
+    uint64_t num_deallocations=0;
+    /// allocations that had to go to the system, after warm-up this should stop growing
+    uint64_t num_system_allocations=0;
+    /// handed out and not yet returned
+    uint64_t bytes_in_use=0;
+    /// returned and kept for reuse
+    uint64_t bytes_cached=0;
+};
+
+/// storage for heap backed matrices
+///
+/// all blocks are aligned to ALIGNMENT bytes so that simd loads never straddle a cache line.
+/// matrices remember the allocator they were allocated from, so the current allocator can be swapped at
+/// any time (e.g. for a benchmark) as long as it outlives the matrices allocated from it.
+class MatrixAllocator{
+    protected:
+        std::atomic<uint64_t> num_allocations{0};
+        std::atomic<uint64_t> num_deallocations{0};
+        std::atomic<uint64_t> num_system_allocations{0};
+        std::atomic<uint64_t> bytes_in_use{0};
+        std::atomic<uint64_t> bytes_cached{0};
+
+        static void* system_allocate(size_t bytes){
+            // aligned_alloc needs a size that is a multiple of the alignment
+            void* block=std::aligned_alloc(ALIGNMENT,(bytes+ALIGNMENT-1)/ALIGNMENT*ALIGNMENT);
+            if(block==nullptr){
+                throw std::bad_alloc();
+            }
+            return block;
+        }
+
+        static MatrixAllocator& default_allocator();
+        static std::atomic<MatrixAllocator*>& current_pointer();
+
+    public:
+        static constexpr size_t ALIGNMENT=64;
+
+        virtual ~MatrixAllocator()=default;
+
+        virtual void* allocate(size_t bytes)=0;
+        /// bytes must be the same as passed to allocate
+        virtual void deallocate(void* block,size_t bytes)=0;
+
+        MatrixAllocationCounters counters()const{
+            MatrixAllocationCounters ret;
+            ret.num_allocations=num_allocations.load(std::memory_order_relaxed);
+            ret.num_deallocations=num_deallocations.load(std::memory_order_relaxed);
+            ret.num_system_allocations=num_system_allocations.load(std::memory_order_relaxed);
+            ret.bytes_in_use=bytes_in_use.load(std::memory_order_relaxed);
+            ret.bytes_cached=bytes_cached.load(std::memory_order_relaxed);
+            return ret;
+        }
+
+        /// allocator used by newly constructed matrices, a MatrixPoolAllocator unless replaced
+        static MatrixAllocator& current(){
+            return *current_pointer().load(std::memory_order_acquire);
+        }
+        /// returns the previous allocator, nullptr restores the default one
+        static MatrixAllocator* set_current(MatrixAllocator* allocator);
+};
+
+/// every allocation goes straight to the system, useful as a baseline
+class MatrixSystemAllocator:public MatrixAllocator{
+    public:
+        void* allocate(size_t bytes)override{
+            num_allocations.fetch_add(1,std::memory_order_relaxed);
+            num_system_allocations.fetch_add(1,std::memory_order_relaxed);
+            bytes_in_use.fetch_add(bytes,std::memory_order_relaxed);
+            return system_allocate(bytes);
+        }
+        void deallocate(void* block,size_t bytes)override{
+            num_deallocations.fetch_add(1,std::memory_order_relaxed);
+            bytes_in_use.fetch_sub(bytes,std::memory_order_relaxed);
+            std::free(block);
+        }
+};
+
+/// keeps returned blocks in free lists per size class and hands them out again
+///
+/// size classes are multiples of ALIGNMENT up to 4*ALIGNMENT, and four per power of two above that, so at
+/// most 25% of a block is unused. a loop that creates and destroys temporaries of the same shapes
+/// reaches a steady state without system allocations after its first iteration.
+class MatrixPoolAllocator:public MatrixAllocator{
+    private:
+        std::mutex mutex;
+        std::unordered_map<size_t,std::vector<void*>> free_blocks;
+        size_t max_cached_bytes;
+
+    public:
+        /// blocks returned while more than max_cached_bytes are cached go back to the system
+        explicit MatrixPoolAllocator(size_t max_cached_bytes=size_t(512)<<20):max_cached_bytes(max_cached_bytes){}
+        MatrixPoolAllocator(MatrixPoolAllocator&)=delete;
+        MatrixPoolAllocator(MatrixPoolAllocator&&)=delete;
+
+        /// blocks still in use are not owned by the pool and must not outlive it
+        ~MatrixPoolAllocator()override{
+            release();
+        }
+
+        static size_t size_class(size_t bytes){
+            size_t units=bytes==0?1:(bytes+ALIGNMENT-1)/ALIGNMENT;
+            if(units>4){
+                // units in (2^k,2^(k+1)] round up to a multiple of 2^(k-2)
+                size_t shift=std::bit_width(units-1)-3;
+                units=(((units-1)>>shift)+1)<<shift;
+            }
+            return units*ALIGNMENT;
+        }
+
+        void* allocate(size_t bytes)override{
+            size_t class_bytes=size_class(bytes);
+            num_allocations.fetch_add(1,std::memory_order_relaxed);
+            bytes_in_use.fetch_add(class_bytes,std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto &blocks=free_blocks[class_bytes];
+                if(!blocks.empty()){
+                    void* block=blocks.back();
+                    blocks.pop_back();
+                    bytes_cached.fetch_sub(class_bytes,std::memory_order_relaxed);
+                    return block;
+                }
+            }
+            num_system_allocations.fetch_add(1,std::memory_order_relaxed);
+            return system_allocate(class_bytes);
+        }
+
+        void deallocate(void* block,size_t bytes)override{
+            size_t class_bytes=size_class(bytes);
+            num_deallocations.fetch_add(1,std::memory_order_relaxed);
+            bytes_in_use.fetch_sub(class_bytes,std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(bytes_cached.load(std::memory_order_relaxed)+class_bytes<=max_cached_bytes){
+                    free_blocks[class_bytes].push_back(block);
+                    bytes_cached.fetch_add(class_bytes,std::memory_order_relaxed);
+                    return;
+                }
+            }
+            std::free(block);
+        }
+
+        /// return all cached blocks to the system
+        void release(){
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto &[class_bytes,blocks]:free_blocks){
+                for(auto block:blocks){
+                    std::free(block);
+                }
+                bytes_cached.fetch_sub(class_bytes*blocks.size(),std::memory_order_relaxed);
+            }
+            free_blocks.clear();
+        }
+};
+
+inline MatrixAllocator& MatrixAllocator::default_allocator(){
+    // function local so that it is constructed before (and destroyed after) any matrix with static storage
+    static MatrixPoolAllocator allocator;
+    return allocator;
+}
+
+inline std::atomic<MatrixAllocator*>& MatrixAllocator::current_pointer(){
+    static std::atomic<MatrixAllocator*> pointer{&default_allocator()};
+    return pointer;
+}
+
+inline MatrixAllocator* MatrixAllocator::set_current(MatrixAllocator* allocator){
+    return current_pointer().exchange(allocator==nullptr?&default_allocator():allocator,std::memory_order_acq_rel);
+}
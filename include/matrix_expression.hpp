@@ -0,0 +1,187 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <matrix_reduce.hpp>
+#include <matrix_simd.hpp>
+#include <thread_pool.hpp>
+
+typedef size_t index_t;
+
+template<index_t ROWS,index_t COLS>
+class Matrix;
+
+/// anything that has a size and can produce the value at a column-major index: Matrix and expression nodes
+template<class T>
+concept MatrixOperand=requires(const T &t,index_t index){
+    {t.eval(index)}->std::convertible_to<float>;
+    {T::rows}->std::convertible_to<index_t>;
+    {T::cols}->std::convertible_to<index_t>;
+};
+
+template<class T>
+struct is_matrix:std::false_type{};
+template<index_t ROWS,index_t COLS>
+struct is_matrix<Matrix<ROWS,COLS>>:std::true_type{};
+
+/// how an operand is held inside an expression node
+/// matrices passed as lvalues are referenced, matrices passed as rvalues are moved into the node (so
+/// `auto e=(a*b)*2.0f;` does not dangle), and nodes themselves are small and copied
+template<class T>
+using expression_operand_t=std::conditional_t<
+    std::is_lvalue_reference_v<T> && is_matrix<std::remove_cvref_t<T>>::value,
+    const std::remove_cvref_t<T>&,
+    std::remove_cvref_t<T>
+>;
+
+/// shared part of all expression nodes
+///
+/// nothing is computed until the expression is assigned to a Matrix or reduced, and then in a single
+/// pass over all operands, without temporaries.
+template<class Derived,index_t ROWS,index_t COLS>
+struct MatrixExpression{
+    static constexpr index_t rows=ROWS;
+    static constexpr index_t cols=COLS;
+
+    const Derived& self()const{
+        return static_cast<const Derived&>(*this);
+    }
+
+    /// write all values to dst, dst may be one of the operands since every value only depends on its own index
+    void evaluate_into(float *dst)const{
+        for(index_t i=0;i<ROWS*COLS;i++){
+            dst[i]=self().eval(i);
+        }
+    }
+
+    Matrix<ROWS,COLS> evaluate()const{
+        return Matrix<ROWS,COLS>(self());
+    }
+
+    /// same chunks, lanes and reduction order as Matrix::sum, so this matches evaluate().sum() exactly
+    double sum()const{
+        return matrix_reduce::reduce<double>(ROWS*COLS,[this](index_t begin,index_t count){
+            double lanes[matrix_simd::SUM_LANES]={};
+            for(index_t i=0;i<count;i++){
+                lanes[i%matrix_simd::SUM_LANES]+=self().eval(begin+i);
+            }
+            return matrix_simd::reduce_sum_lanes(lanes);
+        },[](double a,double b){
+            return a+b;
+        },ThreadPool::global());
+    }
+};
+
+namespace matrix_ops{
+    struct Add{ static float apply(float a,float b){ return a+b; } };
+    struct Subtract{ static float apply(float a,float b){ return a-b; } };
+    /// element-wise, Matrix*Matrix is the matrix product
+    struct Multiply{ static float apply(float a,float b){ return a*b; } };
+    struct Divide{ static float apply(float a,float b){ return a/b; } };
+    struct Negate{ static float apply(float a){ return -a; } };
+}
+
+template<class L,class R,class Op>
+struct MatrixBinaryExpression:MatrixExpression<MatrixBinaryExpression<L,R,Op>,std::remove_cvref_t<L>::rows,std::remove_cvref_t<L>::cols>{
+    L left;
+    R right;
+
+    MatrixBinaryExpression(L left,R right):left(std::forward<L>(left)),right(std::forward<R>(right)){}
+
+    float eval(index_t index)const{
+        return Op::apply(left.eval(index),right.eval(index));
+    }
+
+    void evaluate_into(float *dst)const{
+        // the most common case has a hand vectorized kernel
+        if constexpr(std::is_same_v<Op,matrix_ops::Add> && is_matrix<std::remove_cvref_t<L>>::value && is_matrix<std::remove_cvref_t<R>>::value){
+            matrix_simd::add(dst,left.data(),right.data(),this->rows*this->cols);
+        }else{
+            MatrixExpression<MatrixBinaryExpression<L,R,Op>,std::remove_cvref_t<L>::rows,std::remove_cvref_t<L>::cols>::evaluate_into(dst);
+        }
+    }
+};
+
+/// expression combined with the same scalar at every index
+template<class E,class Op>
+struct MatrixScalarExpression:MatrixExpression<MatrixScalarExpression<E,Op>,std::remove_cvref_t<E>::rows,std::remove_cvref_t<E>::cols>{
+    E expression;
+    float scalar;
+
+    MatrixScalarExpression(E expression,float scalar):expression(std::forward<E>(expression)),scalar(scalar){}
+
+    float eval(index_t index)const{
+        return Op::apply(expression.eval(index),scalar);
+    }
+
+    void evaluate_into(float *dst)const{
+        // the most common case has a hand vectorized kernel
+        if constexpr(std::is_same_v<Op,matrix_ops::Multiply> && is_matrix<std::remove_cvref_t<E>>::value){
+            matrix_simd::scale(dst,expression.data(),scalar,this->rows*this->cols);
+        }else{
+            MatrixExpression<MatrixScalarExpression<E,Op>,std::remove_cvref_t<E>::rows,std::remove_cvref_t<E>::cols>::evaluate_into(dst);
+        }
+    }
+};
+
+template<class E,class Op>
+struct MatrixUnaryExpression:MatrixExpression<MatrixUnaryExpression<E,Op>,std::remove_cvref_t<E>::rows,std::remove_cvref_t<E>::cols>{
+    E expression;
+
+    explicit MatrixUnaryExpression(E expression):expression(std::forward<E>(expression)){}
+
+    float eval(index_t index)const{
+        return Op::apply(expression.eval(index));
+    }
+};
+
+
+template<class L,class R>
+concept SameShapeOperands=MatrixOperand<std::remove_cvref_t<L>> && MatrixOperand<std::remove_cvref_t<R>>
+    && std::remove_cvref_t<L>::rows==std::remove_cvref_t<R>::rows
+    && std::remove_cvref_t<L>::cols==std::remove_cvref_t<R>::cols;
+
+template<class L,class R> requires SameShapeOperands<L,R>
+auto operator+(L &&left,R &&right){
+    return MatrixBinaryExpression<expression_operand_t<L>,expression_operand_t<R>,matrix_ops::Add>(
+        std::forward<L>(left),std::forward<R>(right)
+    );
+}
+
+template<class L,class R> requires SameShapeOperands<L,R>
+auto operator-(L &&left,R &&right){
+    return MatrixBinaryExpression<expression_operand_t<L>,expression_operand_t<R>,matrix_ops::Subtract>(
+        std::forward<L>(left),std::forward<R>(right)
+    );
+}
+
+/// element-wise product, named to avoid confusion with the matrix product
+template<class L,class R> requires SameShapeOperands<L,R>
+auto hadamard(L &&left,R &&right){
+    return MatrixBinaryExpression<expression_operand_t<L>,expression_operand_t<R>,matrix_ops::Multiply>(
+        std::forward<L>(left),std::forward<R>(right)
+    );
+}
+
+template<class E> requires MatrixOperand<std::remove_cvref_t<E>>
+auto operator*(E &&expression,float scalar){
+    return MatrixScalarExpression<expression_operand_t<E>,matrix_ops::Multiply>(std::forward<E>(expression),scalar);
+}
+
+template<class E> requires MatrixOperand<std::remove_cvref_t<E>>
+auto operator*(float scalar,E &&expression){
+    return MatrixScalarExpression<expression_operand_t<E>,matrix_ops::Multiply>(std::forward<E>(expression),scalar);
+}
+
+template<class E> requires MatrixOperand<std::remove_cvref_t<E>>
+auto operator/(E &&expression,float scalar){
+    return MatrixScalarExpression<expression_operand_t<E>,matrix_ops::Divide>(std::forward<E>(expression),scalar);
+}
+
+template<class E> requires MatrixOperand<std::remove_cvref_t<E>>
+auto operator-(E &&expression){
+    return MatrixUnaryExpression<expression_operand_t<E>,matrix_ops::Negate>(std::forward<E>(expression));
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <thread_pool.hpp>
+
+/// cache blocked single precision matrix multiply on column-major storage
+///
+/// the output is split into MC x NC tiles that are computed independently (one parallel_for index each),
+/// so results do not depend on the number of threads. inside a tile, KC deep slices of A and B are packed
+/// into MR row and NR column panels, which the micro kernel streams through while accumulating an MR x NR
+/// block of C in registers.
+namespace matrix_gemm{
+
+/// register block, MR is a multiple of the vector width of every supported instruction set
+constexpr size_t MR=16;
+constexpr size_t NR=6;
+/// cache blocks, a KC x NR panel of B stays in L1 and an MC x KC block of A in L2
+constexpr size_t KC=256;
+constexpr size_t MC=96;
+constexpr size_t NC=192;
+
+/// pack rows [row,row+rows) and k range [k,k+depth) of A (m x k, column-major) into MR row panels,
+/// panel p holds A(row+p*MR+i,k+kk) at p*MR*depth+kk*MR+i, rows past the end are zero
+inline void pack_a(float *packed,const float *a,size_t m,size_t row,size_t rows,size_t k,size_t depth){
+    for(size_t panel_row=0;panel_row<rows;panel_row+=MR){
+        size_t panel_rows=rows-panel_row<MR?rows-panel_row:MR;
+        for(size_t kk=0;kk<depth;kk++){
+            const float *column=a+(k+kk)*m+row+panel_row;
+            size_t i=0;
+            for(;i<panel_rows;i++){
+                packed[i]=column[i];
+            }
+            for(;i<MR;i++){
+                packed[i]=0.0f;
+            }
+            packed+=MR;
+        }
+    }
+}
+
+/// pack columns [col,col+cols) and k range [k,k+depth) of B (k x n, column-major) into NR column panels,
+/// panel p holds B(k+kk,col+p*NR+j) at p*NR*depth+kk*NR+j, columns past the end are zero
+inline void pack_b(float *packed,const float *b,size_t k_total,size_t col,size_t cols,size_t k,size_t depth){
+    for(size_t panel_col=0;panel_col<cols;panel_col+=NR){
+        size_t panel_cols=cols-panel_col<NR?cols-panel_col:NR;
+        for(size_t kk=0;kk<depth;kk++){
+            size_t j=0;
+            for(;j<panel_cols;j++){
+                packed[j]=b[(col+panel_col+j)*k_total+k+kk];
+            }
+            for(;j<NR;j++){
+                packed[j]=0.0f;
+            }
+            packed+=NR;
+        }
+    }
+}
+
+/// C(MR x NR block at c, leading dimension ldc) += packed A panel * packed B panel
+/// only the first rows x cols of the block are written
+inline void micro_kernel(
+    size_t depth,
+    const float *__restrict packed_a,
+    const float *__restrict packed_b,
+    float *__restrict c,
+    size_t ldc,
+    size_t rows,
+    size_t cols
+){
+    // accumulators are MR/VECTOR_WIDTH vectors per column, which the compiler keeps in registers.
+    // vector extensions (gcc and clang) are used instead of intrinsics so that one kernel covers all targets,
+    // the vector width must not exceed the native one though, or the compiler spills to memory
+    #if defined(__AVX__)
+        constexpr size_t VECTOR_WIDTH=8;
+    #else
+        constexpr size_t VECTOR_WIDTH=4;
+    #endif
+    typedef float vector_t __attribute__((vector_size(VECTOR_WIDTH*sizeof(float))));
+    constexpr size_t MR_VECTORS=MR/VECTOR_WIDTH;
+
+    vector_t accumulators_vectors[NR][MR_VECTORS]={};
+    for(size_t kk=0;kk<depth;kk++){
+        vector_t a[MR_VECTORS];
+        std::memcpy(a,packed_a+kk*MR,sizeof(a));
+        const float *b=packed_b+kk*NR;
+        for(size_t j=0;j<NR;j++){
+            for(size_t v=0;v<MR_VECTORS;v++){
+                accumulators_vectors[j][v]+=a[v]*b[j];
+            }
+        }
+    }
+    float accumulators[NR][MR];
+    std::memcpy(accumulators,accumulators_vectors,sizeof(accumulators));
+
+    if(rows==MR && cols==NR){
+        for(size_t j=0;j<NR;j++){
+            for(size_t i=0;i<MR;i++){
+                c[j*ldc+i]+=accumulators[j][i];
+            }
+        }
+    }else{
+        for(size_t j=0;j<cols;j++){
+            for(size_t i=0;i<rows;i++){
+                c[j*ldc+i]+=accumulators[j][i];
+            }
+        }
+    }
+}
+
+/// C (m x n) = A (m x k) * B (k x n), all column-major and without padding between columns
+/// C must not alias A or B
+inline void gemm(float *c,const float *a,const float *b,size_t m,size_t n,size_t k,ThreadPool &thread_pool){
+    size_t num_row_tiles=(m+MC-1)/MC;
+    size_t num_col_tiles=(n+NC-1)/NC;
+
+    thread_pool.parallel_for(num_row_tiles*num_col_tiles,[&](size_t tile){
+        size_t row=(tile%num_row_tiles)*MC;
+        size_t col=(tile/num_row_tiles)*NC;
+        size_t rows=m-row<MC?m-row:MC;
+        size_t cols=n-col<NC?n-col:NC;
+
+        // reused across calls on the same thread
+        thread_local std::vector<float> packed_a;
+        thread_local std::vector<float> packed_b;
+        packed_a.resize(((MC+MR-1)/MR)*MR*KC);
+        packed_b.resize(((NC+NR-1)/NR)*NR*KC);
+
+        for(size_t j=0;j<cols;j++){
+            for(size_t i=0;i<rows;i++){
+                c[(col+j)*m+row+i]=0.0f;
+            }
+        }
+
+        for(size_t kk=0;kk<k;kk+=KC){
+            size_t depth=k-kk<KC?k-kk:KC;
+            pack_a(packed_a.data(),a,m,row,rows,kk,depth);
+            pack_b(packed_b.data(),b,k,col,cols,kk,depth);
+
+            for(size_t panel_col=0;panel_col<cols;panel_col+=NR){
+                for(size_t panel_row=0;panel_row<rows;panel_row+=MR){
+                    micro_kernel(
+                        depth,
+                        packed_a.data()+(panel_row/MR)*MR*depth,
+                        packed_b.data()+(panel_col/NR)*NR*depth,
+                        c+(col+panel_col)*m+row+panel_row,
+                        m,
+                        rows-panel_row<MR?rows-panel_row:MR,
+                        cols-panel_col<NR?cols-panel_col:NR
+                    );
+                }
+            }
+        }
+    });
+}
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <matrix_simd.hpp>
+#include <thread_pool.hpp>
+
+/// parallel reductions over contiguous float arrays, used by Matrix
+///
+/// the input is cut into chunks of CHUNK elements at fixed offsets, each chunk is reduced on its own (in
+/// parallel when there is more than one), and the chunk results are combined pairwise in a tree whose
+/// shape only depends on the number of chunks. results are therefore bitwise identical for any number of
+/// threads, and for a single chunk identical to the serial matrix_simd kernels.
+namespace matrix_reduce{
+
+/// large enough that a chunk amortizes handing it to a thread, small enough to balance 1M elements
+constexpr size_t CHUNK=size_t(1)<<16;
+
+inline size_t num_chunks(size_t n,size_t chunk_size=CHUNK){
+    return n==0?1:(n+chunk_size-1)/chunk_size;
+}
+
+/// combine values[0..n) pairwise: ((v0+v1)+(v2+v3))+..., an odd element is carried to the next level
+template<class T,class Combine>
+T tree_reduce(std::vector<T> values,Combine combine){
+    size_t n=values.size();
+    while(n>1){
+        size_t half=n/2;
+        for(size_t i=0;i<half;i++){
+            values[i]=combine(values[2*i],values[2*i+1]);
+        }
+        if(n%2!=0){
+            values[half]=values[n-1];
+        }
+        n=half+n%2;
+    }
+    return values[0];
+}
+
+/// reduce_chunk(begin,count) for every chunk of chunk_size items, combined with tree_reduce
+template<class T,class ReduceChunk,class Combine>
+T reduce(size_t n,ReduceChunk reduce_chunk,Combine combine,ThreadPool &thread_pool,size_t chunk_size=CHUNK){
+    size_t chunks=num_chunks(n,chunk_size);
+    if(chunks==1){
+        return reduce_chunk(0,n);
+    }
+    std::vector<T> results(chunks);
+    thread_pool.parallel_for(chunks,[&](size_t chunk){
+        size_t begin=chunk*chunk_size;
+        results[chunk]=reduce_chunk(begin,n-begin<chunk_size?n-begin:chunk_size);
+    });
+    return tree_reduce(std::move(results),combine);
+}
+
+inline double sum(const float *src,size_t n,ThreadPool &thread_pool){
+    return reduce<double>(n,[src](size_t begin,size_t count){
+        return matrix_simd::sum(src+begin,count);
+    },[](double a,double b){
+        return a+b;
+    },thread_pool);
+}
+
+/// population variance, from a second pass over the data rather than the sum of squares, which cancels
+inline double variance(const float *src,size_t n,ThreadPool &thread_pool){
+    if(n==0){
+        return 0.0;
+    }
+    double mean=sum(src,n,thread_pool)/n;
+    double squared_deviations=reduce<double>(n,[src,mean](size_t begin,size_t count){
+        return matrix_simd::sum_squared_deviations(src+begin,count,mean);
+    },[](double a,double b){
+        return a+b;
+    },thread_pool);
+    return squared_deviations/n;
+}
+
+struct MinMax{
+    float min;
+    float max;
+
+    static MinMax combine(MinMax a,MinMax b){
+        return MinMax{b.min<a.min?b.min:a.min,b.max>a.max?b.max:a.max};
+    }
+};
+
+/// n must be at least 1
+inline MinMax min_max(const float *src,size_t n,ThreadPool &thread_pool){
+    return reduce<MinMax>(n,[src](size_t begin,size_t count){
+        MinMax ret;
+        matrix_simd::min_max(src+begin,count,ret.min,ret.max);
+        return ret;
+    },MinMax::combine,thread_pool);
+}
+
+/// num_bins (at least 1) equal bins covering [low,high), with low<high
+/// values below the range and NaNs are counted in the first bin, values above it in the last
+struct HistogramBins{
+    size_t num_bins;
+    double low;
+    /// double, so that the bin of a value does not depend on how float rounds the scale
+    double scale;
+
+    HistogramBins(size_t num_bins,float low,float high):num_bins(num_bins),low(low),scale(num_bins/(double(high)-double(low))){}
+
+    /// add the counts of src[0..n) to bins
+    void count(std::vector<uint64_t> &bins,const float *src,size_t n)const{
+        // the bin index computation vectorizes, the scattered increments cannot
+        for(size_t i=0;i<n;i++){
+            double position=(src[i]-low)*scale;
+            size_t bin=position>0.0?(position<num_bins?static_cast<size_t>(position):num_bins-1):0;
+            bins[bin]++;
+        }
+    }
+
+    static std::vector<uint64_t> combine(std::vector<uint64_t> a,const std::vector<uint64_t> &b){
+        for(size_t bin=0;bin<a.size();bin++){
+            a[bin]+=b[bin];
+        }
+        return a;
+    }
+};
+
+/// value counts, see HistogramBins
+inline std::vector<uint64_t> histogram(const float *src,size_t n,size_t num_bins,float low,float high,ThreadPool &thread_pool){
+    HistogramBins histogram_bins(num_bins,low,high);
+    return reduce<std::vector<uint64_t>>(n,[&](size_t begin,size_t count){
+        std::vector<uint64_t> bins(num_bins,0);
+        histogram_bins.count(bins,src+begin,count);
+        return bins;
+    },HistogramBins::combine,thread_pool);
+}
+
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <cstddef>
+
+// define MATRIX_SIMD_FORCE_SCALAR to compare against the scalar fallback
+#if defined(MATRIX_SIMD_FORCE_SCALAR)
+#elif defined(__AVX512F__)
+    #include <immintrin.h>
+    #define MATRIX_SIMD_AVX512
+#elif defined(__AVX2__) || defined(__AVX__)
+    #include <immintrin.h>
+    #define MATRIX_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #include <xmmintrin.h>
+    #define MATRIX_SIMD_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define MATRIX_SIMD_NEON
+#endif
+
+/// element-wise kernels on contiguous float arrays, used by Matrix
+///
+/// the instruction set is picked at compile time from the target flags (e.g. -mavx2 or -march=native),
+/// without any such flags x86-64 uses sse2 and aarch64 uses neon.
+/// every path produces bit identical results to the scalar fallback: element-wise kernels round each
+/// element the same way, and sum() accumulates in a fixed number of double lanes (element i goes into
+/// lane i%SUM_LANES) which are reduced in a fixed order, independent of the vector width.
+namespace matrix_simd{
+
+constexpr size_t SUM_LANES=8;
+
+inline const char* instruction_set(){
+    #if defined(MATRIX_SIMD_AVX512)
+        return "avx512";
+    #elif defined(MATRIX_SIMD_AVX)
+        return "avx";
+    #elif defined(MATRIX_SIMD_SSE)
+        return "sse2";
+    #elif defined(MATRIX_SIMD_NEON)
+        return "neon";
+    #else
+        return "scalar";
+    #endif
+}
+
+/// dst[i]=value
+inline void fill(float *dst,float value,size_t n){
+    size_t i=0;
+    #if defined(MATRIX_SIMD_AVX512)
+        auto v=_mm512_set1_ps(value);
+        for(;i+16<=n;i+=16){
+            _mm512_storeu_ps(dst+i,v);
+        }
+    #elif defined(MATRIX_SIMD_AVX)
+        auto v=_mm256_set1_ps(value);
+        for(;i+8<=n;i+=8){
+            _mm256_storeu_ps(dst+i,v);
+        }
+    #elif defined(MATRIX_SIMD_SSE)
+        auto v=_mm_set1_ps(value);
+        for(;i+4<=n;i+=4){
+            _mm_storeu_ps(dst+i,v);
+        }
+    #elif defined(MATRIX_SIMD_NEON)
+        auto v=vdupq_n_f32(value);
+        for(;i+4<=n;i+=4){
+            vst1q_f32(dst+i,v);
+        }
+    #endif
+    // written as a count rather than i<n, which gcc cannot prove to terminate after the vector loop
+    for(size_t remaining=n-i;remaining>0;remaining--,i++){
+        dst[i]=value;
+    }
+}
+
+/// dst[i]=src[i]*value, dst may alias src
+inline void scale(float *dst,const float *src,float value,size_t n){
+    size_t i=0;
+    #if defined(MATRIX_SIMD_AVX512)
+        auto v=_mm512_set1_ps(value);
+        for(;i+16<=n;i+=16){
+            _mm512_storeu_ps(dst+i,_mm512_mul_ps(_mm512_loadu_ps(src+i),v));
+        }
+    #elif defined(MATRIX_SIMD_AVX)
+        auto v=_mm256_set1_ps(value);
+        for(;i+8<=n;i+=8){
+            _mm256_storeu_ps(dst+i,_mm256_mul_ps(_mm256_loadu_ps(src+i),v));
+        }
+    #elif defined(MATRIX_SIMD_SSE)
+        auto v=_mm_set1_ps(value);
+        for(;i+4<=n;i+=4){
+            _mm_storeu_ps(dst+i,_mm_mul_ps(_mm_loadu_ps(src+i),v));
+        }
+    #elif defined(MATRIX_SIMD_NEON)
+        auto v=vdupq_n_f32(value);
+        for(;i+4<=n;i+=4){
+            vst1q_f32(dst+i,vmulq_f32(vld1q_f32(src+i),v));
+        }
+    #endif
+    for(size_t remaining=n-i;remaining>0;remaining--,i++){
+        dst[i]=src[i]*value;
+    }
+}
+
+/// dst[i]=a[i]+b[i], dst may alias a or b
+inline void add(float *dst,const float *a,const float *b,size_t n){
+    size_t i=0;
+    #if defined(MATRIX_SIMD_AVX512)
+        for(;i+16<=n;i+=16){
+            _mm512_storeu_ps(dst+i,_mm512_add_ps(_mm512_loadu_ps(a+i),_mm512_loadu_ps(b+i)));
+        }
+    #elif defined(MATRIX_SIMD_AVX)
+        for(;i+8<=n;i+=8){
+            _mm256_storeu_ps(dst+i,_mm256_add_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i)));
+        }
+    #elif defined(MATRIX_SIMD_SSE)
+        for(;i+4<=n;i+=4){
+            _mm_storeu_ps(dst+i,_mm_add_ps(_mm_loadu_ps(a+i),_mm_loadu_ps(b+i)));
+        }
+    #elif defined(MATRIX_SIMD_NEON)
+        for(;i+4<=n;i+=4){
+            vst1q_f32(dst+i,vaddq_f32(vld1q_f32(a+i),vld1q_f32(b+i)));
+        }
+    #endif
+    for(size_t remaining=n-i;remaining>0;remaining--,i++){
+        dst[i]=a[i]+b[i];
+    }
+}
+
+/// reduce the sum lanes in a fixed order, shared by all paths
+inline double reduce_sum_lanes(const double (&lanes)[SUM_LANES]){
+    return ((lanes[0]+lanes[4])+(lanes[2]+lanes[6]))+((lanes[1]+lanes[5])+(lanes[3]+lanes[7]));
+}
+
+/// sum of all elements, accumulated in double precision
+inline double sum(const float *src,size_t n){
+    double lanes[SUM_LANES]={};
+    size_t i=0;
+    #if defined(MATRIX_SIMD_AVX512)
+        auto acc=_mm512_setzero_pd();
+        for(;i+8<=n;i+=8){
+            acc=_mm512_add_pd(acc,_mm512_cvtps_pd(_mm256_loadu_ps(src+i)));
+        }
+        _mm512_storeu_pd(lanes,acc);
+    #elif defined(MATRIX_SIMD_AVX)
+        auto acc_low=_mm256_setzero_pd();
+        auto acc_high=_mm256_setzero_pd();
+        for(;i+8<=n;i+=8){
+            acc_low=_mm256_add_pd(acc_low,_mm256_cvtps_pd(_mm_loadu_ps(src+i)));
+            acc_high=_mm256_add_pd(acc_high,_mm256_cvtps_pd(_mm_loadu_ps(src+i+4)));
+        }
+        _mm256_storeu_pd(lanes,acc_low);
+        _mm256_storeu_pd(lanes+4,acc_high);
+    #elif defined(MATRIX_SIMD_SSE)
+        __m128d acc[4]={_mm_setzero_pd(),_mm_setzero_pd(),_mm_setzero_pd(),_mm_setzero_pd()};
+        for(;i+8<=n;i+=8){
+            auto low=_mm_loadu_ps(src+i);
+            auto high=_mm_loadu_ps(src+i+4);
+            acc[0]=_mm_add_pd(acc[0],_mm_cvtps_pd(low));
+            acc[1]=_mm_add_pd(acc[1],_mm_cvtps_pd(_mm_movehl_ps(low,low)));
+            acc[2]=_mm_add_pd(acc[2],_mm_cvtps_pd(high));
+            acc[3]=_mm_add_pd(acc[3],_mm_cvtps_pd(_mm_movehl_ps(high,high)));
+        }
+        for(size_t lane_pair=0;lane_pair<4;lane_pair++){
+            _mm_storeu_pd(lanes+2*lane_pair,acc[lane_pair]);
+        }
+    #elif defined(MATRIX_SIMD_NEON)
+        float64x2_t acc[4]={vdupq_n_f64(0.0),vdupq_n_f64(0.0),vdupq_n_f64(0.0),vdupq_n_f64(0.0)};
+        for(;i+8<=n;i+=8){
+            auto low=vld1q_f32(src+i);
+            auto high=vld1q_f32(src+i+4);
+            acc[0]=vaddq_f64(acc[0],vcvt_f64_f32(vget_low_f32(low)));
+            acc[1]=vaddq_f64(acc[1],vcvt_high_f64_f32(low));
+            acc[2]=vaddq_f64(acc[2],vcvt_f64_f32(vget_low_f32(high)));
+            acc[3]=vaddq_f64(acc[3],vcvt_high_f64_f32(high));
+        }
+        for(size_t lane_pair=0;lane_pair<4;lane_pair++){
+            vst1q_f64(lanes+2*lane_pair,acc[lane_pair]);
+        }
+    #endif
+    for(size_t remaining=n-i;remaining>0;remaining--,i++){
+        lanes[i%SUM_LANES]+=src[i];
+    }
+    return reduce_sum_lanes(lanes);
+}
+
+/// sum of (src[i]-mean)^2, in double precision with the same lanes and reduction order as sum()
+inline double sum_squared_deviations(const float *src,size_t n,double mean){
+    double lanes[SUM_LANES]={};
+    size_t i=0;
+    #if defined(MATRIX_SIMD_AVX512)
+        auto m=_mm512_set1_pd(mean);
+        auto acc=_mm512_setzero_pd();
+        for(;i+8<=n;i+=8){
+            auto d=_mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(src+i)),m);
+            acc=_mm512_add_pd(acc,_mm512_mul_pd(d,d));
+        }
+        _mm512_storeu_pd(lanes,acc);
+    #elif defined(MATRIX_SIMD_AVX)
+        auto m=_mm256_set1_pd(mean);
+        auto acc_low=_mm256_setzero_pd();
+        auto acc_high=_mm256_setzero_pd();
+        for(;i+8<=n;i+=8){
+            auto d_low=_mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(src+i)),m);
+            auto d_high=_mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(src+i+4)),m);
+            acc_low=_mm256_add_pd(acc_low,_mm256_mul_pd(d_low,d_low));
+            acc_high=_mm256_add_pd(acc_high,_mm256_mul_pd(d_high,d_high));
+        }
+        _mm256_storeu_pd(lanes,acc_low);
+        _mm256_storeu_pd(lanes+4,acc_high);
+    #elif defined(MATRIX_SIMD_SSE)
+        auto m=_mm_set1_pd(mean);
+        __m128d acc[4]={_mm_setzero_pd(),_mm_setzero_pd(),_mm_setzero_pd(),_mm_setzero_pd()};
+        for(;i+8<=n;i+=8){
+            auto low=_mm_loadu_ps(src+i);
+            auto high=_mm_loadu_ps(src+i+4);
+            __m128d d[4]={
+                _mm_sub_pd(_mm_cvtps_pd(low),m),
+                _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(low,low)),m),
+                _mm_sub_pd(_mm_cvtps_pd(high),m),
+                _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(high,high)),m)
+            };
+            for(size_t lane_pair=0;lane_pair<4;lane_pair++){
+                acc[lane_pair]=_mm_add_pd(acc[lane_pair],_mm_mul_pd(d[lane_pair],d[lane_pair]));
+            }
+        }
+        for(size_t lane_pair=0;lane_pair<4;lane_pair++){
+            _mm_storeu_pd(lanes+2*lane_pair,acc[lane_pair]);
+        }
+    #elif defined(MATRIX_SIMD_NEON)
+        auto m=vdupq_n_f64(mean);
+        float64x2_t acc[4]={vdupq_n_f64(0.0),vdupq_n_f64(0.0),vdupq_n_f64(0.0),vdupq_n_f64(0.0)};
+        for(;i+8<=n;i+=8){
+            auto low=vld1q_f32(src+i);
+            auto high=vld1q_f32(src+i+4);
+            float64x2_t d[4]={
+                vsubq_f64(vcvt_f64_f32(vget_low_f32(low)),m),
+                vsubq_f64(vcvt_high_f64_f32(low),m),
+                vsubq_f64(vcvt_f64_f32(vget_low_f32(high)),m),
+                vsubq_f64(vcvt_high_f64_f32(high),m)
+            };
+            for(size_t lane_pair=0;lane_pair<4;lane_pair++){
+                // separate multiply and add, like the other paths
+                acc[lane_pair]=vaddq_f64(acc[lane_pair],vmulq_f64(d[lane_pair],d[lane_pair]));
+            }
+        }
+        for(size_t lane_pair=0;lane_pair<4;lane_pair++){
+            vst1q_f64(lanes+2*lane_pair,acc[lane_pair]);
+        }
+    #endif
+    for(size_t remaining=n-i;remaining>0;remaining--,i++){
+        double d=src[i]-mean;
+        lanes[i%SUM_LANES]+=d*d;
+    }
+    return reduce_sum_lanes(lanes);
+}
+
+/// smallest and largest element, n must be at least 1
+/// NaNs are not handled, whether they are skipped depends on their position
+inline void min_max(const float *src,size_t n,float &min,float &max){
+    size_t i=0;
+    min=src[0];
+    max=src[0];
+    #if defined(MATRIX_SIMD_AVX512)
+        if(n>=16){
+            auto vmin=_mm512_loadu_ps(src);
+            auto vmax=vmin;
+            for(i=16;i+16<=n;i+=16){
+                auto v=_mm512_loadu_ps(src+i);
+                vmin=_mm512_min_ps(vmin,v);
+                vmax=_mm512_max_ps(vmax,v);
+            }
+            min=_mm512_reduce_min_ps(vmin);
+            max=_mm512_reduce_max_ps(vmax);
+        }
+    #elif defined(MATRIX_SIMD_AVX)
+        if(n>=8){
+            auto vmin=_mm256_loadu_ps(src);
+            auto vmax=vmin;
+            for(i=8;i+8<=n;i+=8){
+                auto v=_mm256_loadu_ps(src+i);
+                vmin=_mm256_min_ps(vmin,v);
+                vmax=_mm256_max_ps(vmax,v);
+            }
+            float lanes_min[8];
+            float lanes_max[8];
+            _mm256_storeu_ps(lanes_min,vmin);
+            _mm256_storeu_ps(lanes_max,vmax);
+            for(size_t lane=0;lane<8;lane++){
+                min=lanes_min[lane]<min?lanes_min[lane]:min;
+                max=lanes_max[lane]>max?lanes_max[lane]:max;
+            }
+        }
+    #elif defined(MATRIX_SIMD_SSE) || defined(MATRIX_SIMD_NEON)
+        if(n>=4){
+            #if defined(MATRIX_SIMD_NEON)
+                auto vmin=vld1q_f32(src);
+                auto vmax=vmin;
+                for(i=4;i+4<=n;i+=4){
+                    auto v=vld1q_f32(src+i);
+                    vmin=vminq_f32(vmin,v);
+                    vmax=vmaxq_f32(vmax,v);
+                }
+                min=vminvq_f32(vmin);
+                max=vmaxvq_f32(vmax);
+            #else
+                auto vmin=_mm_loadu_ps(src);
+                auto vmax=vmin;
+                for(i=4;i+4<=n;i+=4){
+                    auto v=_mm_loadu_ps(src+i);
+                    vmin=_mm_min_ps(vmin,v);
+                    vmax=_mm_max_ps(vmax,v);
+                }
+                float lanes_min[4];
+                float lanes_max[4];
+                _mm_storeu_ps(lanes_min,vmin);
+                _mm_storeu_ps(lanes_max,vmax);
+                for(size_t lane=0;lane<4;lane++){
+                    min=lanes_min[lane]<min?lanes_min[lane]:min;
+                    max=lanes_max[lane]>max?lanes_max[lane]:max;
+                }
+            #endif
+        }
+    #endif
+    for(size_t remaining=n-i;remaining>0;remaining--,i++){
+        min=src[i]<min?src[i]:min;
+        max=src[i]>max?src[i]:max;
+    }
+}
+
+/// dst[inner_index*outer+outer_index]=src[outer_index*inner+inner_index]
+/// i.e. transposes outer contiguous runs of inner elements, dst must not alias src
+inline void transpose(float *dst,const float *src,size_t outer,size_t inner){
+    // 4x4 blocks, tiled so that a block row of dst and src stays in cache
+    constexpr size_t TILE=32;
+    for(size_t outer_tile=0;outer_tile<outer;outer_tile+=TILE){
+        size_t outer_tile_end=outer_tile+TILE<outer?outer_tile+TILE:outer;
+        for(size_t inner_tile=0;inner_tile<inner;inner_tile+=TILE){
+            size_t inner_tile_end=inner_tile+TILE<inner?inner_tile+TILE:inner;
+
+            size_t o=outer_tile;
+            #if defined(MATRIX_SIMD_AVX512) || defined(MATRIX_SIMD_AVX) || defined(MATRIX_SIMD_SSE) || defined(MATRIX_SIMD_NEON)
+            for(;o+4<=outer_tile_end;o+=4){
+                size_t i=inner_tile;
+                for(;i+4<=inner_tile_end;i+=4){
+                    #if defined(MATRIX_SIMD_NEON)
+                        auto row0=vld1q_f32(src+(o+0)*inner+i);
+                        auto row1=vld1q_f32(src+(o+1)*inner+i);
+                        auto row2=vld1q_f32(src+(o+2)*inner+i);
+                        auto row3=vld1q_f32(src+(o+3)*inner+i);
+                        auto t01=vtrnq_f32(row0,row1);
+                        auto t23=vtrnq_f32(row2,row3);
+                        vst1q_f32(dst+(i+0)*outer+o,vcombine_f32(vget_low_f32(t01.val[0]),vget_low_f32(t23.val[0])));
+                        vst1q_f32(dst+(i+1)*outer+o,vcombine_f32(vget_low_f32(t01.val[1]),vget_low_f32(t23.val[1])));
+                        vst1q_f32(dst+(i+2)*outer+o,vcombine_f32(vget_high_f32(t01.val[0]),vget_high_f32(t23.val[0])));
+                        vst1q_f32(dst+(i+3)*outer+o,vcombine_f32(vget_high_f32(t01.val[1]),vget_high_f32(t23.val[1])));
+                    #else
+                        auto row0=_mm_loadu_ps(src+(o+0)*inner+i);
+                        auto row1=_mm_loadu_ps(src+(o+1)*inner+i);
+                        auto row2=_mm_loadu_ps(src+(o+2)*inner+i);
+                        auto row3=_mm_loadu_ps(src+(o+3)*inner+i);
+                        _MM_TRANSPOSE4_PS(row0,row1,row2,row3);
+                        _mm_storeu_ps(dst+(i+0)*outer+o,row0);
+                        _mm_storeu_ps(dst+(i+1)*outer+o,row1);
+                        _mm_storeu_ps(dst+(i+2)*outer+o,row2);
+                        _mm_storeu_ps(dst+(i+3)*outer+o,row3);
+                    #endif
+                }
+                for(;i<inner_tile_end;i++){
+                    for(size_t block_o=o;block_o<o+4;block_o++){
+                        dst[i*outer+block_o]=src[block_o*inner+i];
+                    }
+                }
+            }
+            #endif
+            for(;o<outer_tile_end;o++){
+                for(size_t i=inner_tile;i<inner_tile_end;i++){
+                    dst[i*outer+o]=src[o*inner+i];
+                }
+            }
+        }
+    }
+}
+
+}
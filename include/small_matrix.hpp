@@ -0,0 +1,340 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#include <matrix.hpp>
+#include <matrix_simd.hpp>
+
+/// 3 and 4 component vectors and 4x4 matrices for transforms and per-agent math
+///
+/// these are separate from Matrix so that they can be literal types: every operation is constexpr and
+/// fully unrolled. at runtime, the operations that do not vectorize well on their own (Mat4 products,
+/// Vec4 dot products, transpose) use sse/neon registers directly. Vec3::dot stays scalar, three products
+/// do not fill a register, but a Vec3 is still padded to 4 floats so that it can be loaded as one.
+/// results are identical between compile time and runtime, except for the rounding of sqrt in normalize(), and
+/// for multiply-adds that the compiler contracts into fma at runtime (gcc does by default when fma is enabled).
+namespace small_matrix_detail{
+    /// sqrt usable in constant expressions, std::sqrt is only constexpr from c++26
+    constexpr float sqrt(float value){
+        if(std::is_constant_evaluated()){
+            if(value<=0.0f){
+                return 0.0f;
+            }
+            double x=value;
+            double previous=0.0;
+            while(x!=previous){
+                previous=x;
+                x=0.5*(x+value/x);
+            }
+            return static_cast<float>(x);
+        }
+        return std::sqrt(value);
+    }
+}
+
+class alignas(16) Vec3{
+    public:
+        /// x, y, z and one float of padding that is always 0
+        float v[4]{};
+
+        constexpr Vec3()=default;
+        constexpr Vec3(float x,float y,float z):v{x,y,z,0.0f}{}
+        constexpr explicit Vec3(float s):v{s,s,s,0.0f}{}
+        explicit Vec3(const Matrix<3,1> &m):v{m.data()[0],m.data()[1],m.data()[2],0.0f}{}
+
+        constexpr float x()const{ return v[0]; }
+        constexpr float y()const{ return v[1]; }
+        constexpr float z()const{ return v[2]; }
+        constexpr float operator[](index_t index)const{ return v[index]; }
+        constexpr float& operator[](index_t index){ return v[index]; }
+
+        constexpr Vec3 operator+(const Vec3 &o)const{ return {v[0]+o.v[0],v[1]+o.v[1],v[2]+o.v[2]}; }
+        constexpr Vec3 operator-(const Vec3 &o)const{ return {v[0]-o.v[0],v[1]-o.v[1],v[2]-o.v[2]}; }
+        constexpr Vec3 operator-()const{ return {-v[0],-v[1],-v[2]}; }
+        constexpr Vec3 operator*(float s)const{ return {v[0]*s,v[1]*s,v[2]*s}; }
+        constexpr Vec3 operator/(float s)const{ return {v[0]/s,v[1]/s,v[2]/s}; }
+        constexpr bool operator==(const Vec3 &o)const{ return v[0]==o.v[0] && v[1]==o.v[1] && v[2]==o.v[2]; }
+
+        constexpr float dot(const Vec3 &o)const{
+            return v[0]*o.v[0]+v[1]*o.v[1]+v[2]*o.v[2];
+        }
+        constexpr Vec3 cross(const Vec3 &o)const{
+            return {
+                v[1]*o.v[2]-v[2]*o.v[1],
+                v[2]*o.v[0]-v[0]*o.v[2],
+                v[0]*o.v[1]-v[1]*o.v[0]
+            };
+        }
+        constexpr float length()const{
+            return small_matrix_detail::sqrt(dot(*this));
+        }
+        /// zero vectors stay zero
+        constexpr Vec3 normalized()const{
+            float l=length();
+            return l>0.0f?*this/l:*this;
+        }
+
+        Matrix<3,1> matrix()const{
+            return Matrix<3,1>({v[0],v[1],v[2]});
+        }
+};
+
+constexpr Vec3 operator*(float s,const Vec3 &v){ return v*s; }
+
+class alignas(16) Vec4{
+    public:
+        float v[4]{};
+
+        constexpr Vec4()=default;
+        constexpr Vec4(float x,float y,float z,float w):v{x,y,z,w}{}
+        constexpr explicit Vec4(float s):v{s,s,s,s}{}
+        constexpr Vec4(const Vec3 &xyz,float w):v{xyz.v[0],xyz.v[1],xyz.v[2],w}{}
+        explicit Vec4(const Matrix<4,1> &m):v{m.data()[0],m.data()[1],m.data()[2],m.data()[3]}{}
+
+        constexpr float x()const{ return v[0]; }
+        constexpr float y()const{ return v[1]; }
+        constexpr float z()const{ return v[2]; }
+        constexpr float w()const{ return v[3]; }
+        constexpr Vec3 xyz()const{ return {v[0],v[1],v[2]}; }
+        constexpr float operator[](index_t index)const{ return v[index]; }
+        constexpr float& operator[](index_t index){ return v[index]; }
+
+        constexpr Vec4 operator+(const Vec4 &o)const{ return {v[0]+o.v[0],v[1]+o.v[1],v[2]+o.v[2],v[3]+o.v[3]}; }
+        constexpr Vec4 operator-(const Vec4 &o)const{ return {v[0]-o.v[0],v[1]-o.v[1],v[2]-o.v[2],v[3]-o.v[3]}; }
+        constexpr Vec4 operator-()const{ return {-v[0],-v[1],-v[2],-v[3]}; }
+        constexpr Vec4 operator*(float s)const{ return {v[0]*s,v[1]*s,v[2]*s,v[3]*s}; }
+        constexpr Vec4 operator/(float s)const{ return {v[0]/s,v[1]/s,v[2]/s,v[3]/s}; }
+        constexpr bool operator==(const Vec4 &o)const{ return v[0]==o.v[0] && v[1]==o.v[1] && v[2]==o.v[2] && v[3]==o.v[3]; }
+
+        /// summed as (x+y)+(z+w) in both paths
+        constexpr float dot(const Vec4 &o)const{
+            if(!std::is_constant_evaluated()){
+                #if defined(MATRIX_SIMD_SSE) || defined(MATRIX_SIMD_AVX) || defined(MATRIX_SIMD_AVX512)
+                    auto products=_mm_mul_ps(_mm_load_ps(v),_mm_load_ps(o.v));
+                    // (x+y, y+x, z+w, w+z), then (x+y)+(z+w)
+                    auto pairs=_mm_add_ps(products,_mm_shuffle_ps(products,products,_MM_SHUFFLE(2,3,0,1)));
+                    return _mm_cvtss_f32(_mm_add_ss(pairs,_mm_movehl_ps(pairs,pairs)));
+                #elif defined(MATRIX_SIMD_NEON)
+                    auto products=vmulq_f32(vld1q_f32(v),vld1q_f32(o.v));
+                    auto pairs=vpaddq_f32(products,products);
+                    return vgetq_lane_f32(pairs,0)+vgetq_lane_f32(pairs,1);
+                #endif
+            }
+            return (v[0]*o.v[0]+v[1]*o.v[1])+(v[2]*o.v[2]+v[3]*o.v[3]);
+        }
+        constexpr float length()const{
+            return small_matrix_detail::sqrt(dot(*this));
+        }
+        /// zero vectors stay zero
+        constexpr Vec4 normalized()const{
+            float l=length();
+            return l>0.0f?*this/l:*this;
+        }
+
+        Matrix<4,1> matrix()const{
+            return Matrix<4,1>({v[0],v[1],v[2],v[3]});
+        }
+};
+
+constexpr Vec4 operator*(float s,const Vec4 &v){ return v*s; }
+
+/// 4x4 matrix, column-major like Matrix
+class alignas(16) Mat4{
+    public:
+        /// element (row,col) is m[col*4+row]
+        float m[16]{};
+
+        constexpr Mat4()=default;
+        /// all elements set to s
+        constexpr explicit Mat4(float s):m{s,s,s,s,s,s,s,s,s,s,s,s,s,s,s,s}{}
+        constexpr Mat4(const Vec4 &c0,const Vec4 &c1,const Vec4 &c2,const Vec4 &c3)
+        :m{
+            c0.v[0],c0.v[1],c0.v[2],c0.v[3],
+            c1.v[0],c1.v[1],c1.v[2],c1.v[3],
+            c2.v[0],c2.v[1],c2.v[2],c2.v[3],
+            c3.v[0],c3.v[1],c3.v[2],c3.v[3]
+        }{}
+        explicit Mat4(const Matrix<4,4> &matrix){
+            for(index_t i=0;i<16;i++){
+                m[i]=matrix.data()[i];
+            }
+        }
+
+        static constexpr Mat4 identity(){
+            return Mat4(
+                Vec4(1.0f,0.0f,0.0f,0.0f),
+                Vec4(0.0f,1.0f,0.0f,0.0f),
+                Vec4(0.0f,0.0f,1.0f,0.0f),
+                Vec4(0.0f,0.0f,0.0f,1.0f)
+            );
+        }
+
+        constexpr float operator()(index_t row,index_t col)const{ return m[col*4+row]; }
+        constexpr float& operator()(index_t row,index_t col){ return m[col*4+row]; }
+        constexpr Vec4 column(index_t col)const{ return {m[col*4],m[col*4+1],m[col*4+2],m[col*4+3]}; }
+
+        constexpr bool operator==(const Mat4 &o)const{
+            for(index_t i=0;i<16;i++){
+                if(m[i]!=o.m[i]){
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// column j of the result is sum over k of column k times o(k,j), accumulated in k order in both paths
+        constexpr Mat4 operator*(const Mat4 &o)const{
+            Mat4 result;
+            if(!std::is_constant_evaluated()){
+                #if defined(MATRIX_SIMD_SSE) || defined(MATRIX_SIMD_AVX) || defined(MATRIX_SIMD_AVX512)
+                    __m128 columns[4]={_mm_load_ps(m),_mm_load_ps(m+4),_mm_load_ps(m+8),_mm_load_ps(m+12)};
+                    for(index_t j=0;j<4;j++){
+                        auto c=_mm_mul_ps(columns[0],_mm_set1_ps(o.m[j*4]));
+                        c=_mm_add_ps(c,_mm_mul_ps(columns[1],_mm_set1_ps(o.m[j*4+1])));
+                        c=_mm_add_ps(c,_mm_mul_ps(columns[2],_mm_set1_ps(o.m[j*4+2])));
+                        c=_mm_add_ps(c,_mm_mul_ps(columns[3],_mm_set1_ps(o.m[j*4+3])));
+                        _mm_store_ps(result.m+j*4,c);
+                    }
+                    return result;
+                #elif defined(MATRIX_SIMD_NEON)
+                    float32x4_t columns[4]={vld1q_f32(m),vld1q_f32(m+4),vld1q_f32(m+8),vld1q_f32(m+12)};
+                    for(index_t j=0;j<4;j++){
+                        // separate multiply and add, fused vmlaq would round differently from the constexpr path
+                        auto c=vmulq_n_f32(columns[0],o.m[j*4]);
+                        c=vaddq_f32(c,vmulq_n_f32(columns[1],o.m[j*4+1]));
+                        c=vaddq_f32(c,vmulq_n_f32(columns[2],o.m[j*4+2]));
+                        c=vaddq_f32(c,vmulq_n_f32(columns[3],o.m[j*4+3]));
+                        vst1q_f32(result.m+j*4,c);
+                    }
+                    return result;
+                #endif
+            }
+            for(index_t j=0;j<4;j++){
+                for(index_t i=0;i<4;i++){
+                    float e=m[i]*o.m[j*4];
+                    e+=m[4+i]*o.m[j*4+1];
+                    e+=m[8+i]*o.m[j*4+2];
+                    e+=m[12+i]*o.m[j*4+3];
+                    result.m[j*4+i]=e;
+                }
+            }
+            return result;
+        }
+
+        constexpr Vec4 operator*(const Vec4 &v)const{
+            Vec4 result;
+            for(index_t i=0;i<4;i++){
+                float e=m[i]*v.v[0];
+                e+=m[4+i]*v.v[1];
+                e+=m[8+i]*v.v[2];
+                e+=m[12+i]*v.v[3];
+                result.v[i]=e;
+            }
+            return result;
+        }
+
+        constexpr Mat4 operator*(float s)const{
+            Mat4 result;
+            for(index_t i=0;i<16;i++){
+                result.m[i]=m[i]*s;
+            }
+            return result;
+        }
+
+        constexpr Mat4 transposed()const{
+            Mat4 result;
+            if(!std::is_constant_evaluated()){
+                #if defined(MATRIX_SIMD_SSE) || defined(MATRIX_SIMD_AVX) || defined(MATRIX_SIMD_AVX512)
+                    auto c0=_mm_load_ps(m);
+                    auto c1=_mm_load_ps(m+4);
+                    auto c2=_mm_load_ps(m+8);
+                    auto c3=_mm_load_ps(m+12);
+                    _MM_TRANSPOSE4_PS(c0,c1,c2,c3);
+                    _mm_store_ps(result.m,c0);
+                    _mm_store_ps(result.m+4,c1);
+                    _mm_store_ps(result.m+8,c2);
+                    _mm_store_ps(result.m+12,c3);
+                    return result;
+                #endif
+            }
+            for(index_t row=0;row<4;row++){
+                for(index_t col=0;col<4;col++){
+                    result.m[row*4+col]=m[col*4+row];
+                }
+            }
+            return result;
+        }
+
+        /// inverse through the adjugate, a singular matrix returns all zeros
+        constexpr Mat4 inverse()const{
+            // 2x2 sub-determinants of the two upper and the two lower rows
+            float s0=m[0]*m[5]-m[4]*m[1];
+            float s1=m[0]*m[9]-m[8]*m[1];
+            float s2=m[0]*m[13]-m[12]*m[1];
+            float s3=m[4]*m[9]-m[8]*m[5];
+            float s4=m[4]*m[13]-m[12]*m[5];
+            float s5=m[8]*m[13]-m[12]*m[9];
+
+            float c5=m[10]*m[15]-m[14]*m[11];
+            float c4=m[6]*m[15]-m[14]*m[7];
+            float c3=m[6]*m[11]-m[10]*m[7];
+            float c2=m[2]*m[15]-m[14]*m[3];
+            float c1=m[2]*m[11]-m[10]*m[3];
+            float c0=m[2]*m[7]-m[6]*m[3];
+
+            float determinant=s0*c5-s1*c4+s2*c3+s3*c2-s4*c1+s5*c0;
+            if(determinant==0.0f){
+                return Mat4();
+            }
+            float inverse_determinant=1.0f/determinant;
+
+            Mat4 result;
+            result.m[0]=( m[5]*c5-m[9]*c4+m[13]*c3)*inverse_determinant;
+            result.m[4]=(-m[4]*c5+m[8]*c4-m[12]*c3)*inverse_determinant;
+            result.m[8]=( m[7]*s5-m[11]*s4+m[15]*s3)*inverse_determinant;
+            result.m[12]=(-m[6]*s5+m[10]*s4-m[14]*s3)*inverse_determinant;
+
+            result.m[1]=(-m[1]*c5+m[9]*c2-m[13]*c1)*inverse_determinant;
+            result.m[5]=( m[0]*c5-m[8]*c2+m[12]*c1)*inverse_determinant;
+            result.m[9]=(-m[3]*s5+m[11]*s2-m[15]*s1)*inverse_determinant;
+            result.m[13]=( m[2]*s5-m[10]*s2+m[14]*s1)*inverse_determinant;
+
+            result.m[2]=( m[1]*c4-m[5]*c2+m[13]*c0)*inverse_determinant;
+            result.m[6]=(-m[0]*c4+m[4]*c2-m[12]*c0)*inverse_determinant;
+            result.m[10]=( m[3]*s4-m[7]*s2+m[15]*s0)*inverse_determinant;
+            result.m[14]=(-m[2]*s4+m[6]*s2-m[14]*s0)*inverse_determinant;
+
+            result.m[3]=(-m[1]*c3+m[5]*c1-m[9]*c0)*inverse_determinant;
+            result.m[7]=( m[0]*c3-m[4]*c1+m[8]*c0)*inverse_determinant;
+            result.m[11]=(-m[3]*s3+m[7]*s1-m[11]*s0)*inverse_determinant;
+            result.m[15]=( m[2]*s3-m[6]*s1+m[10]*s0)*inverse_determinant;
+            return result;
+        }
+
+        Matrix<4,4> matrix()const{
+            Matrix<4,4> result;
+            for(index_t i=0;i<16;i++){
+                result.data()[i]=m[i];
+            }
+            return result;
+        }
+};
+
+// the types must stay usable in constant expressions, with results exact for these inputs
+namespace small_matrix_detail{
+    constexpr Mat4 rotation_and_translation=Mat4(
+        Vec4(0.0f,1.0f,0.0f,0.0f),
+        Vec4(-1.0f,0.0f,0.0f,0.0f),
+        Vec4(0.0f,0.0f,1.0f,0.0f),
+        Vec4(2.0f,-3.0f,0.5f,1.0f)
+    );
+    static_assert(Mat4::identity().inverse()==Mat4::identity());
+    static_assert(rotation_and_translation*rotation_and_translation.inverse()==Mat4::identity());
+    static_assert(rotation_and_translation.transposed().transposed()==rotation_and_translation);
+    static_assert(Vec3(1.0f,0.0f,0.0f).cross(Vec3(0.0f,1.0f,0.0f))==Vec3(0.0f,0.0f,1.0f));
+    static_assert(Vec3(3.0f,0.0f,4.0f).normalized()==Vec3(0.6f,0.0f,0.8f));
+    static_assert(Vec4(0.0f,0.0f,0.0f,2.0f).normalized()==Vec4(0.0f,0.0f,0.0f,1.0f));
+    static_assert(Vec3().normalized()==Vec3());
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// fixed set of worker threads that run parallel loops
+///
+/// parallel_for hands out indices through a shared counter, so uneven work per index balances itself.
+/// the calling thread works on the loop as well, which also makes nested parallel_for calls from inside
+/// a loop body safe (they may just end up running on fewer threads).
+class ThreadPool{
+    private:
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::deque<std::function<void()>> jobs;
+        bool stopping=false;
+
+        void worker_loop(){
+            while(true){
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work_available.wait(lock,[&]{return stopping || !jobs.empty();});
+                    if(jobs.empty()){
+                        return;
+                    }
+                    job=std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+    public:
+        /// num_threads includes the calling thread, 0 uses one thread per hardware thread
+        explicit ThreadPool(size_t num_threads=0){
+            if(num_threads==0){
+                num_threads=std::max<size_t>(1,std::thread::hardware_concurrency());
+            }
+            for(size_t i=1;i<num_threads;i++){
+                workers.emplace_back([this]{worker_loop();});
+            }
+        }
+        ThreadPool(ThreadPool&)=delete;
+        ThreadPool(ThreadPool&&)=delete;
+
+        ~ThreadPool(){
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping=true;
+            }
+            work_available.notify_all();
+            for(auto &worker:workers){
+                worker.join();
+            }
+        }
+
+        /// number of threads working on a parallel_for, including the caller
+        size_t num_threads()const{
+            return workers.size()+1;
+        }
+
+        /// call func(i) for every i in [0,n), returns once all calls have returned
+        void parallel_for(size_t n,const std::function<void(size_t)> &func){
+            if(n==0){
+                return;
+            }
+            if(n==1 || workers.empty()){
+                for(size_t i=0;i<n;i++){
+                    func(i);
+                }
+                return;
+            }
+
+            // shared with the helper jobs, which may only get to run after the loop is over
+            struct Loop{
+                std::atomic<size_t> next_index{0};
+                std::mutex mutex;
+                std::condition_variable done;
+                /// set once the caller has stopped working on the loop, helpers that start afterwards do nothing
+                bool closed=false;
+                size_t num_active_helpers=0;
+            };
+            auto loop=std::make_shared<Loop>();
+
+            auto run_indices=[&func,n](Loop &loop){
+                for(size_t i=loop.next_index++;i<n;i=loop.next_index++){
+                    func(i);
+                }
+            };
+
+            size_t num_helpers=std::min(workers.size(),n-1);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for(size_t helper=0;helper<num_helpers;helper++){
+                    jobs.push_back([loop,run_indices]{
+                        {
+                            std::lock_guard<std::mutex> loop_lock(loop->mutex);
+                            if(loop->closed){
+                                return;
+                            }
+                            loop->num_active_helpers++;
+                        }
+                        run_indices(*loop);
+                        std::lock_guard<std::mutex> loop_lock(loop->mutex);
+                        loop->num_active_helpers--;
+                        loop->done.notify_one();
+                    });
+                }
+            }
+            work_available.notify_all();
+
+            run_indices(*loop);
+
+            // only wait for helpers that actually started, queued ones may be stuck behind busy workers
+            // (e.g. for nested loops) and would deadlock otherwise
+            std::unique_lock<std::mutex> loop_lock(loop->mutex);
+            loop->closed=true;
+            loop->done.wait(loop_lock,[&]{return loop->num_active_helpers==0;});
+        }
+
+        /// pool shared by everything that does not need its own, created on first use
+        static ThreadPool& global(){
+            static ThreadPool pool;
+            return pool;
+        }
+};
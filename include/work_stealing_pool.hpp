@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// fixed set of worker threads that run parallel loops over index ranges, balanced by work stealing
+///
+/// unlike ThreadPool, which hands out single indices through one shared counter, every thread starts
+/// out with its own contiguous part of the range and takes grain sized pieces from its front, so
+/// neighbouring indices (e.g. rows of a tile) stay on the same thread. a thread that runs out steals the
+/// back half of another thread's remaining range.
+/// parallel_for called from inside a loop body runs serially on the calling thread.
+class WorkStealingPool{
+    private:
+        /// indices [begin,end) not yet taken, owned by one thread but shared with thieves
+        struct alignas(64) Range{
+            std::mutex mutex;
+            size_t begin=0;
+            size_t end=0;
+        };
+
+        struct Loop{
+            const std::function<void(size_t,size_t)> *func;
+            size_t grain;
+            std::vector<Range> ranges;
+            /// indices not yet completed
+            std::atomic<size_t> remaining;
+            /// range index of the next thread that joins, the caller has 0
+            std::atomic<size_t> next_participant{1};
+
+            std::mutex done_mutex;
+            std::condition_variable done;
+
+            Loop(const std::function<void(size_t,size_t)> *func,size_t grain,size_t n,size_t num_ranges)
+            :func(func),grain(grain),ranges(num_ranges),remaining(n){
+                for(size_t i=0;i<num_ranges;i++){
+                    ranges[i].begin=n*i/num_ranges;
+                    ranges[i].end=n*(i+1)/num_ranges;
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::shared_ptr<Loop> current_loop;
+        /// incremented for every loop, so that each worker joins each loop at most once
+        uint64_t loop_generation=0;
+        bool stopping=false;
+
+        static bool& inside_loop(){
+            thread_local bool inside=false;
+            return inside;
+        }
+
+        /// take up to grain indices from the front of a range
+        static bool take(Range &range,size_t grain,size_t &begin,size_t &end){
+            std::lock_guard<std::mutex> lock(range.mutex);
+            if(range.begin==range.end){
+                return false;
+            }
+            begin=range.begin;
+            end=std::min(range.end,begin+grain);
+            range.begin=end;
+            return true;
+        }
+
+        /// move the back half of some other range into ranges[self], which must be empty
+        static bool steal(Loop &loop,size_t self){
+            size_t num_ranges=loop.ranges.size();
+            for(size_t offset=1;offset<num_ranges;offset++){
+                auto &victim=loop.ranges[(self+offset)%num_ranges];
+                size_t begin;
+                size_t end;
+                {
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    size_t size=victim.end-victim.begin;
+                    if(size==0){
+                        continue;
+                    }
+                    // small ranges are taken whole, the victim is about to finish them anyway
+                    begin=size<=loop.grain?victim.begin:victim.end-size/2;
+                    end=victim.end;
+                    victim.end=begin;
+                }
+                auto &own=loop.ranges[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.begin=begin;
+                own.end=end;
+                return true;
+            }
+            return false;
+        }
+
+        static void participate(Loop &loop,size_t self){
+            inside_loop()=true;
+            while(true){
+                size_t begin;
+                size_t end;
+                if(!take(loop.ranges[self],loop.grain,begin,end)){
+                    if(!steal(loop,self)){
+                        break;
+                    }
+                    continue;
+                }
+                (*loop.func)(begin,end);
+                if(loop.remaining.fetch_sub(end-begin,std::memory_order_acq_rel)==end-begin){
+                    std::lock_guard<std::mutex> lock(loop.done_mutex);
+                    loop.done.notify_all();
+                }
+            }
+            inside_loop()=false;
+        }
+
+        void worker_loop(){
+            uint64_t last_generation=0;
+            while(true){
+                std::shared_ptr<Loop> loop;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work_available.wait(lock,[&]{return stopping || loop_generation!=last_generation;});
+                    if(stopping){
+                        return;
+                    }
+                    last_generation=loop_generation;
+                    loop=current_loop;
+                }
+                // a worker that only wakes up after the loop is over finds all ranges empty
+                size_t self=loop->next_participant++;
+                if(self<loop->ranges.size()){
+                    participate(*loop,self);
+                }
+            }
+        }
+
+    public:
+        /// num_threads includes the calling thread, 0 uses one thread per hardware thread
+        explicit WorkStealingPool(size_t num_threads=0){
+            if(num_threads==0){
+                num_threads=std::max<size_t>(1,std::thread::hardware_concurrency());
+            }
+            for(size_t i=1;i<num_threads;i++){
+                workers.emplace_back([this]{worker_loop();});
+            }
+        }
+        WorkStealingPool(WorkStealingPool&)=delete;
+        WorkStealingPool(WorkStealingPool&&)=delete;
+
+        ~WorkStealingPool(){
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping=true;
+            }
+            work_available.notify_all();
+            for(auto &worker:workers){
+                worker.join();
+            }
+        }
+
+        /// number of threads working on a parallel_for, including the caller
+        size_t num_threads()const{
+            return workers.size()+1;
+        }
+
+        /// call func(begin,end) on disjoint ranges covering [0,n), each at most grain long,
+        /// returns once all calls have returned
+        void parallel_for(size_t n,size_t grain,const std::function<void(size_t,size_t)> &func){
+            if(n==0){
+                return;
+            }
+            grain=std::max<size_t>(grain,1);
+            if(workers.empty() || n<=grain || inside_loop()){
+                for(size_t begin=0;begin<n;begin+=grain){
+                    func(begin,std::min(n,begin+grain));
+                }
+                return;
+            }
+
+            auto loop=std::make_shared<Loop>(&func,grain,n,num_threads());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current_loop=loop;
+                loop_generation++;
+            }
+            work_available.notify_all();
+
+            participate(*loop,0);
+
+            // stolen ranges may still be running on other threads
+            std::unique_lock<std::mutex> done_lock(loop->done_mutex);
+            loop->done.wait(done_lock,[&]{return loop->remaining.load(std::memory_order_acquire)==0;});
+        }
+};
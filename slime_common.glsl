@@ -0,0 +1,39 @@
+// shared between all slime simulation kernels, must match SimulationPushConstants in include/application/simulation.h
+
+struct Agent{
+    vec2 position;
+    float angle;
+    float padding;
+};
+
+layout(push_constant) uniform Parameters{
+    uint num_agents;
+    uint trail_width;
+    uint trail_height;
+    uint seed;
+    float move_speed;
+    float turn_speed;
+    float sensor_angle;
+    float sensor_distance;
+    int sensor_size;
+    float deposit;
+    float decay;
+    float diffuse;
+} params;
+
+const float PI=3.14159265359;
+
+// pcg hash, stateless so that every step is reproducible from (seed, step, agent index)
+uint hash(uint state){
+    state=state*747796405u+2891336453u;
+    uint word=((state>>((state>>28u)+4u))^state)*277803737u;
+    return (word>>22u)^word;
+}
+float random01(uint h){
+    return float(h)/4294967295.0;
+}
+
+// agents are dispatched as a 2d grid of 1d workgroups to get around maxComputeWorkGroupCount[0]
+uint agent_index(){
+    return gl_GlobalInvocationID.x+gl_GlobalInvocationID.y*gl_NumWorkGroups.x*gl_WorkGroupSize.x;
+}
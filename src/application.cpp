@@ -3,6 +3,7 @@
 #include "application/window.h"
 #include "vk_video/vulkan_video_codec_h265std.h"
 #include "vulkan/vulkan_metal.h"
+#include <algorithm>
 #include <chrono>
 #include <ios>
 #include <stdexcept>
@@ -16,49 +17,12 @@
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
-VkShaderModule create_shader_module(
-    std::shared_ptr<VulkanContext> vulkan,
-    std::string filepath
-){
-    std::ifstream shader_module_file{filepath};
-    if (!shader_module_file) {
-        throw  std::runtime_error("vertex shader file does not exist");
-    }
-    shader_module_file.seekg(0,std::ios::end);
-    auto shader_module_file_size=shader_module_file.tellg();
-    shader_module_file.seekg(0,std::ios::beg);
-
-    std::vector<uint32_t> shader_module_bytes(shader_module_file_size);
-    shader_module_file.read((char*)(shader_module_bytes.data()), shader_module_file_size);
-
-    shader_module_file.close();
-
-    VkShaderModuleCreateInfo shader_module_create_info{
-        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        nullptr,
-        0,
-        static_cast<uint32_t>(shader_module_file_size),
-        shader_module_bytes.data()
-    };
-    VkShaderModule shader_module;
-    auto shader_module_create_res=vkCreateShaderModule(
-        vulkan->device, 
-        &shader_module_create_info, 
-        vulkan->allocator, 
-        &shader_module
-    );
-    if (shader_module_create_res!=VK_SUCCESS) {
-        throw  std::runtime_error("vertex_shader_module_create_res failed");
-    }
-
-    return  shader_module;
-}
-
 GraphicsPipeline::GraphicsPipeline(
     std::shared_ptr<VulkanContext> vulkan,
-    VkRenderPass vk_render_pass
-){
-    std::vector<VkDescriptorSetLayout> graphics_pipeline_set_layouts{};
+    VkRenderPass vk_render_pass,
+    const std::vector<VkDescriptorSetLayout> &descriptor_set_layouts
+):vulkan(vulkan){
+    std::vector<VkDescriptorSetLayout> graphics_pipeline_set_layouts=descriptor_set_layouts;
     std::vector<VkPushConstantRange> graphics_pipeline_push_constant_ranges{};
     VkPipelineLayoutCreateInfo graphics_pipeline_layout_create_info{
         VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
@@ -70,15 +34,16 @@ GraphicsPipeline::GraphicsPipeline(
         graphics_pipeline_push_constant_ranges.data()
     };
     VkPipelineLayout graphics_pipeline_layout;
-    vkCreatePipelineLayout(
+    auto graphics_pipeline_layout_create_res=vkCreatePipelineLayout(
         vulkan->device,
         &graphics_pipeline_layout_create_info,
         vulkan->allocator,
         &graphics_pipeline_layout
     );
+    VulkanError::check(VulkanErrorContext::CreatePipelineLayout,graphics_pipeline_layout_create_res);
 
-    VkShaderModule vertex_shader_module=create_shader_module( vulkan, "vertex_shader.spv" );
-    VkShaderModule fragment_shader_module=create_shader_module( vulkan, "fragment_shader.spv" );
+    VkShaderModule vertex_shader_module=vulkan->shader_registry->get("vertex_shader.spv");
+    VkShaderModule fragment_shader_module=vulkan->shader_registry->get("fragment_shader.spv");
 
     std::vector<VkPipelineShaderStageCreateInfo> pipeline_stages{
         VkPipelineShaderStageCreateInfo{
@@ -115,26 +80,29 @@ GraphicsPipeline::GraphicsPipeline(
         VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
         nullptr,
         0,
-        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
         VK_FALSE
     };
-    VkViewport pipeline_viewport{
-        0.0,0.0,
-        500,500,
-        0.0,1.0
-    };
-    VkRect2D pipeline_scissor{
-        {0,0},
-        {500,500}
-    };
+    // viewport and scissor are set at record time, since they change with the window size
     VkPipelineViewportStateCreateInfo pipeline_viewport_state{
         VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         nullptr,
         0,
         1,
-        &pipeline_viewport,
+        nullptr,
         1,
-        &pipeline_scissor
+        nullptr
+    };
+    std::vector<VkDynamicState> dynamic_states{
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamic_state{
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        nullptr,
+        0,
+        static_cast<uint32_t>(dynamic_states.size()),
+        dynamic_states.data()
     };
     VkPipelineRasterizationStateCreateInfo rasterization_state{
         VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
@@ -143,7 +111,7 @@ GraphicsPipeline::GraphicsPipeline(
         VK_FALSE,
         VK_FALSE,
         VK_POLYGON_MODE_FILL,
-        VK_CULL_MODE_BACK_BIT,
+        VK_CULL_MODE_NONE,
         VK_FRONT_FACE_CLOCKWISE,
         VK_FALSE,
         0.0,
@@ -151,6 +119,17 @@ GraphicsPipeline::GraphicsPipeline(
         0.0,
         1.0
     };
+    VkPipelineMultisampleStateCreateInfo multisample_state{
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        nullptr,
+        0,
+        VK_SAMPLE_COUNT_1_BIT,
+        VK_FALSE,
+        1.0,
+        nullptr,
+        VK_FALSE,
+        VK_FALSE
+    };
     std::vector<VkPipelineColorBlendAttachmentState> graphics_pipeline_color_blend_attachment_states{
         VkPipelineColorBlendAttachmentState{
             VK_FALSE,
@@ -185,10 +164,10 @@ GraphicsPipeline::GraphicsPipeline(
             nullptr,
             &pipeline_viewport_state,
             &rasterization_state,
-            nullptr,
+            &multisample_state,
             nullptr,
             &color_blend_state,
-            nullptr,
+            &dynamic_state,
             graphics_pipeline_layout,
             vk_render_pass,
             0,
@@ -197,28 +176,135 @@ GraphicsPipeline::GraphicsPipeline(
         }
     };
     VkPipeline graphics_pipeline_handle;
-    auto graphics_pipeline_create_res=vkCreateGraphicsPipelines(
+    VkResult graphics_pipeline_create_res;
+    if(vulkan->pipeline_cache){
+        graphics_pipeline_create_res=vulkan->pipeline_cache->create_graphics_pipeline(
+            graphics_pipeline_create_infos[0],
+            graphics_pipeline_handle,
+            "fullscreen triangle"
+        );
+    }else{
+        graphics_pipeline_create_res=vkCreateGraphicsPipelines(
+            vulkan->device,
+            VK_NULL_HANDLE,
+            static_cast<uint32_t>(graphics_pipeline_create_infos.size()),
+            graphics_pipeline_create_infos.data(),
+            vulkan->allocator,
+            &graphics_pipeline_handle
+        );
+    }
+    VulkanError::check(VulkanErrorContext::CreateGraphicsPipelines,graphics_pipeline_create_res);
+
+    layout=graphics_pipeline_layout;
+    handle=graphics_pipeline_handle;
+}
+
+GraphicsPipeline::~GraphicsPipeline(){
+    vkDestroyPipeline(vulkan->device,handle,vulkan->allocator);
+    vkDestroyPipelineLayout(vulkan->device,layout,vulkan->allocator);
+}
+
+ComputePipeline::ComputePipeline(
+    std::shared_ptr<VulkanContext> vulkan,
+    std::string shader_filepath,
+    const std::vector<VkDescriptorSetLayout> &descriptor_set_layouts,
+    uint32_t push_constant_size
+):vulkan(vulkan){
+    std::vector<VkPushConstantRange> compute_pipeline_push_constant_ranges{};
+    if(push_constant_size>0){
+        compute_pipeline_push_constant_ranges.push_back(VkPushConstantRange{
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            push_constant_size
+        });
+    }
+    VkPipelineLayoutCreateInfo compute_pipeline_layout_create_info{
+        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        nullptr,
+        0,
+        static_cast<uint32_t>(descriptor_set_layouts.size()),
+        descriptor_set_layouts.data(),
+        static_cast<uint32_t>(compute_pipeline_push_constant_ranges.size()),
+        compute_pipeline_push_constant_ranges.data()
+    };
+    auto res=vkCreatePipelineLayout(
         vulkan->device,
-        VK_NULL_HANDLE,
-        static_cast<uint32_t>(graphics_pipeline_create_infos.size()),
-        graphics_pipeline_create_infos.data(),
+        &compute_pipeline_layout_create_info,
         vulkan->allocator,
-        &graphics_pipeline_handle
+        &layout
     );
-    VulkanError::check(VulkanErrorContext::CreateGraphicsPipelines,graphics_pipeline_create_res);
+    VulkanError::check(VulkanErrorContext::CreatePipelineLayout,res);
+
+    VkShaderModule compute_shader_module=vulkan->shader_registry->get(shader_filepath);
+
+    std::vector<VkComputePipelineCreateInfo> compute_pipeline_create_infos{
+        VkComputePipelineCreateInfo{
+            VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            nullptr,
+            0,
+            VkPipelineShaderStageCreateInfo{
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                nullptr,
+                0,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                compute_shader_module,
+                "main",
+                nullptr
+            },
+            layout,
+            VK_NULL_HANDLE,
+            0
+        }
+    };
+    if(vulkan->pipeline_cache){
+        res=vulkan->pipeline_cache->create_compute_pipeline(
+            compute_pipeline_create_infos[0],
+            handle,
+            shader_filepath.c_str()
+        );
+    }else{
+        res=vkCreateComputePipelines(
+            vulkan->device,
+            VK_NULL_HANDLE,
+            static_cast<uint32_t>(compute_pipeline_create_infos.size()),
+            compute_pipeline_create_infos.data(),
+            vulkan->allocator,
+            &handle
+        );
+    }
+    VulkanError::check(VulkanErrorContext::CreateComputePipelines,res);
+}
+
+ComputePipeline::~ComputePipeline(){
+    vkDestroyPipeline(vulkan->device,handle,vulkan->allocator);
+    vkDestroyPipelineLayout(vulkan->device,layout,vulkan->allocator);
 }
 
-Application::Application(){
+Application::Application(
+    const ApplicationOptions &options
+):options(options){
+    if(options.frames_in_flight==0){
+        throw std::runtime_error("frames_in_flight must be at least 1");
+    }
+
     #ifdef VK_USE_PLATFORM_XCB_KHR
-    xcb_connection=xcb_connect(
-        nullptr,
-        nullptr
-    );
+    if(!options.headless){
+        xcb_connection=xcb_connect(
+            nullptr,
+            nullptr
+        );
+    }
     #endif
 
+    // validation layers are only enabled if installed, e.g. render farm nodes usually only have the driver
+    bool validation_layer_available=false;
+
     std::cout<<"supported instance layers:"<<std::endl;
     for(auto instance_layer_property:Application::enumerateInstanceLayerProperties()){
         std::cout<<"  "<<instance_layer_property.layerName<<std::endl;
+        if(std::string(instance_layer_property.layerName)=="VK_LAYER_KHRONOS_validation"){
+            validation_layer_available=true;
+        }
 
         auto layerExtensions=Application::enumerateInstanceExtensionProperties(instance_layer_property.layerName);
         if(layerExtensions.size()>0){
@@ -229,9 +315,16 @@ Application::Application(){
         }
     }
 
+    // a vulkan 1.0 instance needs it for device extensions that extend vkGetPhysicalDeviceFeatures2,
+    // e.g. VK_KHR_timeline_semaphore
+    bool physical_device_properties2_available=false;
+
     std::cout<<"supported instance extensions:"<<std::endl;
     for(auto instance_layer_property:Application::enumerateInstanceExtensionProperties(nullptr)){
         std::cout<<"  "<<instance_layer_property.extensionName<<std::endl;
+        if(std::string(instance_layer_property.extensionName)==VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME){
+            physical_device_properties2_available=true;
+        }
     }
 
     auto application_info=VkApplicationInfo{
@@ -243,19 +336,26 @@ Application::Application(){
         VK_MAKE_API_VERSION(0, 0, 1, 0),
         VK_API_VERSION_1_0
     };
-    std::vector<const char*>instance_layers{
-        "VK_LAYER_KHRONOS_validation"
-    };
+    std::vector<const char*>instance_layers{};
+    if(validation_layer_available){
+        instance_layers.push_back("VK_LAYER_KHRONOS_validation");
+    }
     std::vector<const char*>instance_extensions{
-        "VK_KHR_surface",
-        #ifdef VK_USE_PLATFORM_XCB_KHR
-            "VK_KHR_xcb_surface",
-        #elif VK_USE_PLATFORM_METAL_EXT
-            VK_EXT_METAL_SURFACE_EXTENSION_NAME,
+        #ifdef VK_USE_PLATFORM_METAL_EXT
             "VK_KHR_portability_enumeration",
-            "VK_KHR_get_physical_device_properties2"
         #endif
     };
+    if(physical_device_properties2_available){
+        instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    }
+    if(!options.headless){
+        instance_extensions.push_back("VK_KHR_surface");
+        #ifdef VK_USE_PLATFORM_XCB_KHR
+            instance_extensions.push_back("VK_KHR_xcb_surface");
+        #elif VK_USE_PLATFORM_METAL_EXT
+            instance_extensions.push_back(VK_EXT_METAL_SURFACE_EXTENSION_NAME);
+        #endif
+    }
 
     VkInstanceCreateInfo instance_create_info{
         VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -280,163 +380,103 @@ Application::Application(){
     );
     VulkanError::check(VulkanErrorContext::InstanceCreation,res);
 
-    std::vector<const char*> device_layers{
-        "VK_LAYER_KHRONOS_validation"
-    };
+    std::vector<const char*> device_layers=instance_layers;
     std::vector<const char*> device_extensions{
-        "VK_KHR_swapchain",
         #ifdef  VK_USE_PLATFORM_METAL_EXT
         "VK_KHR_portability_subset",
         #endif
     };
-
-    uint32_t num_physical_devices;
-    vkEnumeratePhysicalDevices(vk_instance,&num_physical_devices,nullptr);
-    std::vector<VkPhysicalDevice> physical_devices(num_physical_devices);
-    vkEnumeratePhysicalDevices(vk_instance,&num_physical_devices,physical_devices.data());
+    if(!options.headless){
+        device_extensions.push_back("VK_KHR_swapchain");
+    }
 
     VkPhysicalDevice vk_physical_device=VK_NULL_HANDLE;
+    bool pipeline_creation_feedback_enabled=false;
     {
-        auto temp_vulkan=std::make_shared<VulkanContext>(vk_allocator,vk_instance,VK_NULL_HANDLE,VK_NULL_HANDLE);
-        auto test_window=create_window(100,100,temp_vulkan);
-
-        for(auto physical_device:physical_devices){
-            bool device_is_usable=false;
-
-            auto _=defer([&]()->void {
-                if(device_is_usable){
-                    std::cout<<"-- viable device found"<<std::endl;
-                }else{
-                    std::cout<<"-- device is not viable"<<std::endl;
-                }
-            });
-
-            uint32_t num_device_layer_properties=0;
-            vkEnumerateDeviceLayerProperties(physical_device,&num_device_layer_properties,nullptr);
-            std::vector<VkLayerProperties> device_layer_properties(num_device_layer_properties);
-            vkEnumerateDeviceLayerProperties(physical_device,&num_device_layer_properties,device_layer_properties.data());
-            std::cout<<"device layers:"<<std::endl;
-            for(auto device_layer_property:device_layer_properties){
-                std::cout<<"  "<<device_layer_property.layerName<<std::endl;
-            }
-
-            uint32_t num_device_extension_properties=0;
-            vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &num_device_extension_properties, nullptr);
-            std::vector<VkExtensionProperties> device_extension_properties(num_device_extension_properties);
-            vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &num_device_extension_properties, device_extension_properties.data());
-            std::cout<<"device extensions:"<<std::endl;
-            for(auto device_extension_property:device_extension_properties){
-                std::cout<<"  "<<device_extension_property.extensionName<<std::endl;
-            }
-
-            VkPhysicalDeviceProperties physical_device_properties;
-            vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
-            std::cout << physical_device_properties.deviceName << " : ";
-
-            // we want some gpu
-            switch(physical_device_properties.deviceType){
-                case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-                    std::cout<<"DISCRETE_GPU"<<std::endl;
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-                    std::cout<<"INTEGRATED_GPU"<<std::endl;
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
-                    std::cout<<"VIRTUAL_GPU"<<std::endl;
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_CPU:
-                    std::cout<<"CPU"<<std::endl;
-                    continue;
-                case VK_PHYSICAL_DEVICE_TYPE_OTHER:
-                    std::cout<<"DEVICE_TYPE_OTHER"<<std::endl;
-                    continue;
-                default:
-                    std::cout<<"warning - found invalid vulkan device"<<std::endl;
-                    continue;
-            }
-
-            uint32_t physical_device_num_queue_family_properties;
-            vkGetPhysicalDeviceQueueFamilyProperties(
-                physical_device, 
-                &physical_device_num_queue_family_properties, 
-                nullptr
-            );
-            std::vector<VkQueueFamilyProperties> physical_device_queue_family_properties(physical_device_num_queue_family_properties);
-            vkGetPhysicalDeviceQueueFamilyProperties(
-                physical_device, 
-                &physical_device_num_queue_family_properties, 
-                physical_device_queue_family_properties.data()
-            );
-
-            vk_present_queue_family_index=-1;
-            vk_graphics_queue_family_index=-1;
-
-            int queue_family_index=0;
-            for(auto queue_family:physical_device_queue_family_properties){
-                std::cout<<"  "<<queue_family.queueCount<<" queues allowed of family "<<queue_family_index<<std::endl;
+        // presentation support can only be queried against a surface, which headless mode does not have
+        std::shared_ptr<Window> test_window;
+        if(!options.headless){
+            auto temp_vulkan=std::make_shared<VulkanContext>(vk_allocator,vk_instance,VK_NULL_HANDLE,VK_NULL_HANDLE);
+            test_window=create_window(100,100,temp_vulkan);
+        }
 
-                bool supports_transfer=(queue_family.queueFlags&VK_QUEUE_TRANSFER_BIT)>0;
-                bool supports_graphics=(queue_family.queueFlags&VK_QUEUE_GRAPHICS_BIT)>0;
+        auto candidates=enumerate_physical_device_candidates(
+            vk_instance,
+            test_window?test_window->vk_surface:VK_NULL_HANDLE,
+            device_extensions,
+            options.device_selection
+        );
+        const auto &selected_device=select_physical_device(candidates,options.device_selection);
+
+        vk_physical_device=selected_device.physical_device;
+        vk_graphics_queue_family_index=selected_device.graphics_queue_family_index;
+        vk_present_queue_family_index=selected_device.present_queue_family_index;
+        // a dedicated transfer queue lets uploads and readbacks overlap with the simulation
+        vk_transfer_queue_family_index=selected_device.dedicated_transfer_queue_family_index;
+        if(vk_transfer_queue_family_index==UINT32_MAX){
+            vk_transfer_queue_family_index=vk_graphics_queue_family_index;
+        }
 
-                auto supports_presentation=VK_FALSE;
-                auto res=vkGetPhysicalDeviceSurfaceSupportKHR(
-                    physical_device, 
-                    queue_family_index, 
-                    test_window->vk_surface,
-                    &supports_presentation
-                );
-                if(res!=VK_SUCCESS){
-                    std::cout<<"failed vkGetPhysicalDeviceSurfaceSupportKHR with "<<res<<std::endl;
-                    throw std::runtime_error("vkGetPhysicalDeviceSurfaceSupportKHR failed");
-                }
+        // track completion per queue, without it resources are only released after waiting for the device to become idle
+        if(physical_device_properties2_available && selected_device.supports_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)){
+            timeline_semaphores=true;
+            device_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        }
 
-                // use separate queue families for each queue to avoid the currently unhandled case of a queue family supporting both features, but not supporting 2 individual queues
-                if(supports_presentation && vk_present_queue_family_index==-1){
-                    vk_present_queue_family_index=queue_family_index;
-                }
-                if(supports_graphics && vk_graphics_queue_family_index==-1 && vk_present_queue_family_index!=queue_family_index){
-                    vk_graphics_queue_family_index=queue_family_index;
-                }
-                
-                queue_family_index++;
-            }
+        // a compute only queue lets simulation steps overlap with rendering, which synchronises with it through timeline semaphores
+        // the cpu backend records no steps, its uploads are drawn directly
+        if(
+            options.async_compute
+            && options.simulation_backend==SimulationBackend::Gpu
+            && selected_device.dedicated_compute_queue_family_index!=UINT32_MAX
+            && timeline_semaphores
+        ){
+            async_compute=true;
+            vk_compute_queue_family_index=selected_device.dedicated_compute_queue_family_index;
+        }
 
-            device_is_usable=true;
-            vk_physical_device=physical_device;
+        // optional, only used to report pipeline cache hits
+        if(selected_device.supports_extension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)){
+            device_extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+            pipeline_creation_feedback_enabled=true;
         }
     }
 
-    if(vk_physical_device==VK_NULL_HANDLE){
-        throw VulkanError(VulkanErrorContext::NoViablePhysicalDeviceFound);
+    // one queue per used family, graphics and present usually share a family
+    std::vector<uint32_t> used_queue_family_indices{vk_graphics_queue_family_index};
+    if(!options.headless && vk_present_queue_family_index!=vk_graphics_queue_family_index){
+        used_queue_family_indices.push_back(vk_present_queue_family_index);
     }
-
-    std::vector<float> queue_priorities{
-        1.0,
-        1.0
-    };
-    std::vector<VkDeviceQueueCreateInfo> queue_create_infos{
-        VkDeviceQueueCreateInfo{
-            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-            nullptr,
-            0,
-            vk_present_queue_family_index,
-            1,
-            &queue_priorities[0]
-        },
-        VkDeviceQueueCreateInfo{
+    if(vk_transfer_queue_family_index!=vk_graphics_queue_family_index && vk_transfer_queue_family_index!=vk_present_queue_family_index){
+        used_queue_family_indices.push_back(vk_transfer_queue_family_index);
+    }
+    // compute only, so never the graphics or transfer family
+    if(async_compute && vk_compute_queue_family_index!=vk_present_queue_family_index){
+        used_queue_family_indices.push_back(vk_compute_queue_family_index);
+    }
+    float queue_priority=1.0;
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+    for(auto queue_family_index:used_queue_family_indices){
+        queue_create_infos.push_back(VkDeviceQueueCreateInfo{
             VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             nullptr,
             0,
-            vk_graphics_queue_family_index,
+            queue_family_index,
             1,
-            &queue_priorities[1]
-        },
-    };
+            &queue_priority
+        });
+    }
     auto device_features_enabled=VkPhysicalDeviceFeatures{};
     memset(&device_features_enabled,0,sizeof(device_features_enabled));
+    // always supported if the extension is
+    auto timeline_semaphore_features=VkPhysicalDeviceTimelineSemaphoreFeatures{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        nullptr,
+        VK_TRUE
+    };
     auto device_create_info=VkDeviceCreateInfo{
         VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        nullptr,
+        timeline_semaphores?&timeline_semaphore_features:nullptr,
         0,
         static_cast<uint32_t>(queue_create_infos.size()),
         queue_create_infos.data(),
@@ -459,26 +499,62 @@ Application::Application(){
     this->vulkan=std::make_shared<VulkanContext>(vk_allocator,vk_instance,vk_physical_device,vk_device);
     vulkan->deviceWaitIdle();
 
+    vulkan->shader_registry=std::make_shared<ShaderRegistry>(vulkan->device,vulkan->allocator);
+
+    if(!options.pipeline_cache_directory.empty()){
+        vulkan->pipeline_cache=std::make_shared<PipelineCache>(
+            vulkan->device,
+            vulkan->allocator,
+            vulkan->physical_device,
+            options.pipeline_cache_directory,
+            pipeline_creation_feedback_enabled
+        );
+    }
+
     // get queues
     vkGetDeviceQueue(
         vk_device,
-        vk_present_queue_family_index,
+        vk_graphics_queue_family_index,
         0,
-        &vk_present_queue
+        &vk_graphics_queue
     );
+    if(!options.headless){
+        vkGetDeviceQueue(
+            vk_device,
+            vk_present_queue_family_index,
+            0,
+            &vk_present_queue
+        );
+    }
     vkGetDeviceQueue(
         vk_device,
-        vk_graphics_queue_family_index,
+        vk_transfer_queue_family_index,
         0,
-        &vk_graphics_queue
+        &vk_transfer_queue
     );
+    if(async_compute){
+        vkGetDeviceQueue(
+            vk_device,
+            vk_compute_queue_family_index,
+            0,
+            &vk_compute_queue
+        );
+    }
 
-    this->window=create_window(500,500);
+    auto swapchain_policy=options.frame_pacing==FramePacing::VSync?SwapchainPolicy::PowerSaving:SwapchainPolicy::LowLatency;
+    if(options.swapchain_policy){
+        swapchain_policy=*options.swapchain_policy;
+    }
+    VkFormat render_target_format=offscreen_format;
+    if(!options.headless){
+        this->window=create_window(500,500,{},swapchain_policy);
+        render_target_format=window->vk_swapchain_surface_format.format;
+    }
 
     std::vector<VkAttachmentDescription> render_pass_attachments{
         VkAttachmentDescription{
             0,
-            window->vk_swapchain_surface_format.format,
+            render_target_format,
             VK_SAMPLE_COUNT_1_BIT,
             VK_ATTACHMENT_LOAD_OP_CLEAR,
             VK_ATTACHMENT_STORE_OP_STORE,
@@ -550,240 +626,1177 @@ Application::Application(){
     );
     VulkanError::check(VulkanErrorContext::CreateRenderPass,res);
 
-    this->window->create_framebuffers(vk_render_pass);
+    if(options.headless){
+        vulkan->create_image(
+            options.headless_width,
+            options.headless_height,
+            offscreen_format,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            offscreen_image,
+            offscreen_image_memory,
+            offscreen_image_view
+        );
 
-    auto create_semaphore_info=VkSemaphoreCreateInfo{
-        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        nullptr,
-        0
-    };
-    res=vkCreateSemaphore(vulkan->device,&create_semaphore_info,vulkan->allocator,&vk_image_available_semaphore_handle);
-    VulkanError::check(VulkanErrorContext::CreateSwapchain,res);
+        auto offscreen_framebuffer_create_info=VkFramebufferCreateInfo{
+            VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            nullptr,
+            0,
+            vk_render_pass,
+            1,
+            &offscreen_image_view,
+            options.headless_width,
+            options.headless_height,
+            1
+        };
+        res=vkCreateFramebuffer(vulkan->device,&offscreen_framebuffer_create_info,vulkan->allocator,&offscreen_framebuffer);
+        VulkanError::check(VulkanErrorContext::CreateFramebuffer,res);
+    }else{
+        this->window->create_framebuffers(vk_render_pass);
 
-    vk_image_available_semaphore=std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,vk_image_available_semaphore_handle);
-    
-    res=vkCreateSemaphore(vulkan->device,&create_semaphore_info,vulkan->allocator,&vk_rendering_finished_semaphore_handle);
-    VulkanError::check(VulkanErrorContext::CreateSwapchain,res);
+        auto present_command_pool_create_info=VkCommandPoolCreateInfo{
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            nullptr,
+            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            vk_present_queue_family_index
+        };
+        res=vkCreateCommandPool(vulkan->device,&present_command_pool_create_info,vulkan->allocator,&present_vk_command_pool);
+        VulkanError::check(VulkanErrorContext::CreateCommandPool,res);
 
-    vk_rendering_finished_semaphore=std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,vk_rendering_finished_semaphore_handle);
+        auto present_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            nullptr,
+            present_vk_command_pool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1
+        };
+        present_command_buffers.resize(present_command_buffer_allocate_info.commandBufferCount);
+        res=vkAllocateCommandBuffers(vulkan->device,&present_command_buffer_allocate_info,present_command_buffers.data());
+        VulkanError::check(VulkanErrorContext::AllocateCommandBuffers,res);
+    }
 
-    auto present_command_pool_create_info=VkCommandPoolCreateInfo{
+    auto graphics_command_pool_create_info=VkCommandPoolCreateInfo{
         VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         nullptr,
         VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        vk_present_queue_family_index
+        vk_graphics_queue_family_index
     };
-    res=vkCreateCommandPool(vulkan->device,&present_command_pool_create_info,vulkan->allocator,&present_vk_command_pool);
+    res=vkCreateCommandPool(vulkan->device,&graphics_command_pool_create_info,vulkan->allocator,&graphics_vk_command_pool);
     VulkanError::check(VulkanErrorContext::CreateCommandPool,res);
 
-    auto present_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
+    auto graphics_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         nullptr,
-        present_vk_command_pool,
+        graphics_vk_command_pool,
         VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        1
+        options.frames_in_flight
     };
-    present_command_buffers.resize(present_command_buffer_allocate_info.commandBufferCount);
-    res=vkAllocateCommandBuffers(vulkan->device,&present_command_buffer_allocate_info,present_command_buffers.data());
+    graphics_command_buffers.resize(graphics_command_buffer_allocate_info.commandBufferCount);
+    res=vkAllocateCommandBuffers(vulkan->device,&graphics_command_buffer_allocate_info,graphics_command_buffers.data());
     VulkanError::check(VulkanErrorContext::AllocateCommandBuffers,res);
 
-    auto graphics_command_pool_create_info=VkCommandPoolCreateInfo{
+    auto transfer_command_pool_create_info=VkCommandPoolCreateInfo{
         VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         nullptr,
         VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        vk_graphics_queue_family_index
+        vk_transfer_queue_family_index
     };
-    res=vkCreateCommandPool(vulkan->device,&graphics_command_pool_create_info,vulkan->allocator,&graphics_vk_command_pool);
+    res=vkCreateCommandPool(vulkan->device,&transfer_command_pool_create_info,vulkan->allocator,&transfer_vk_command_pool);
     VulkanError::check(VulkanErrorContext::CreateCommandPool,res);
 
-    auto graphics_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
+    // one upload and one readback command buffer per frame
+    auto transfer_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         nullptr,
-        graphics_vk_command_pool,
+        transfer_vk_command_pool,
         VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        1
+        2*options.frames_in_flight
     };
-    graphics_command_buffers.resize(graphics_command_buffer_allocate_info.commandBufferCount);
-    res=vkAllocateCommandBuffers(vulkan->device,&graphics_command_buffer_allocate_info,graphics_command_buffers.data());
+    transfer_command_buffers.resize(transfer_command_buffer_allocate_info.commandBufferCount);
+    res=vkAllocateCommandBuffers(vulkan->device,&transfer_command_buffer_allocate_info,transfer_command_buffers.data());
     VulkanError::check(VulkanErrorContext::AllocateCommandBuffers,res);
 
-    auto graphics_pipeline_object=GraphicsPipeline(vulkan,vk_render_pass);
-}
+    if(async_compute){
+        auto compute_command_pool_create_info=VkCommandPoolCreateInfo{
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            nullptr,
+            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            vk_compute_queue_family_index
+        };
+        res=vkCreateCommandPool(vulkan->device,&compute_command_pool_create_info,vulkan->allocator,&compute_vk_command_pool);
+        VulkanError::check(VulkanErrorContext::CreateCommandPool,res);
 
-Application::~Application(){
-    if(vulkan->device!=VK_NULL_HANDLE){
-        vkDestroyCommandPool(vulkan->device,present_vk_command_pool,vulkan->allocator);
-        vkFreeCommandBuffers(vulkan->device,present_vk_command_pool,present_command_buffers.size(),present_command_buffers.data());
-        vkDestroyCommandPool(vulkan->device,graphics_vk_command_pool,vulkan->allocator);
-        vkFreeCommandBuffers(vulkan->device,graphics_vk_command_pool,graphics_command_buffers.size(),graphics_command_buffers.data());
+        auto compute_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            nullptr,
+            compute_vk_command_pool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            options.frames_in_flight
+        };
+        compute_command_buffers.resize(compute_command_buffer_allocate_info.commandBufferCount);
+        res=vkAllocateCommandBuffers(vulkan->device,&compute_command_buffer_allocate_info,compute_command_buffers.data());
+        VulkanError::check(VulkanErrorContext::AllocateCommandBuffers,res);
+    }
 
-        vulkan->deviceWaitIdle();
+    auto create_semaphore_info=VkSemaphoreCreateInfo{
+        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        nullptr,
+        0
+    };
+    // fences start signaled so that waiting on a frame that was never submitted returns immediately
+    auto create_fence_info=VkFenceCreateInfo{
+        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        nullptr,
+        VK_FENCE_CREATE_SIGNALED_BIT
+    };
+    for(uint32_t frame_index=0;frame_index<options.frames_in_flight;frame_index++){
+        VkSemaphore image_available_semaphore_handle;
+        res=vkCreateSemaphore(vulkan->device,&create_semaphore_info,vulkan->allocator,&image_available_semaphore_handle);
+        VulkanError::check(VulkanErrorContext::CreateSemaphore,res);
+
+        VkSemaphore rendering_finished_semaphore_handle;
+        res=vkCreateSemaphore(vulkan->device,&create_semaphore_info,vulkan->allocator,&rendering_finished_semaphore_handle);
+        VulkanError::check(VulkanErrorContext::CreateSemaphore,res);
+
+        VkFence in_flight_fence_handle;
+        res=vkCreateFence(vulkan->device,&create_fence_info,vulkan->allocator,&in_flight_fence_handle);
+        VulkanError::check(VulkanErrorContext::CreateFence,res);
+
+        VkSemaphore transfer_semaphore_handles[3];
+        for(auto &transfer_semaphore_handle:transfer_semaphore_handles){
+            res=vkCreateSemaphore(vulkan->device,&create_semaphore_info,vulkan->allocator,&transfer_semaphore_handle);
+            VulkanError::check(VulkanErrorContext::CreateSemaphore,res);
+        }
 
-        window.reset();
+        // only waited on after a transfer submission, see FrameResources::transfer_submitted
+        auto create_transfer_fence_info=VkFenceCreateInfo{
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            nullptr,
+            0
+        };
+        VkFence transfer_fence_handle;
+        res=vkCreateFence(vulkan->device,&create_transfer_fence_info,vulkan->allocator,&transfer_fence_handle);
+        VulkanError::check(VulkanErrorContext::CreateFence,res);
+
+        frames.push_back(FrameResources{
+            graphics_command_buffers[frame_index],
+            std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,image_available_semaphore_handle),
+            std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,rendering_finished_semaphore_handle),
+            std::make_shared<Fence>(vulkan->device,vulkan->allocator,in_flight_fence_handle),
+            transfer_command_buffers[2*frame_index],
+            transfer_command_buffers[2*frame_index+1],
+            std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,transfer_semaphore_handles[0]),
+            std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,transfer_semaphore_handles[1]),
+            std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,transfer_semaphore_handles[2]),
+            std::make_shared<Fence>(vulkan->device,vulkan->allocator,transfer_fence_handle)
+        });
+        // the graphics submission of the frame waits for its step, so the frame's fence also covers this
+        if(async_compute){
+            frames.back().compute_command_buffer=compute_command_buffers[frame_index];
+        }
+        if(!timeline_semaphores){
+            VkSemaphore steps_finished_semaphore_handle;
+            res=vkCreateSemaphore(vulkan->device,&create_semaphore_info,vulkan->allocator,&steps_finished_semaphore_handle);
+            VulkanError::check(VulkanErrorContext::CreateSemaphore,res);
+            frames.back().steps_finished_semaphore=std::make_shared<Semaphore>(vulkan->device,vulkan->allocator,steps_finished_semaphore_handle);
+        }
+    }
 
-        vkDestroyRenderPass(
+    if(timeline_semaphores){
+        graphics_timeline=std::make_shared<Timeline>(vulkan->device,vulkan->allocator);
+        transfer_timeline=std::make_shared<Timeline>(vulkan->device,vulkan->allocator);
+        std::vector<std::shared_ptr<Timeline>> queue_timelines{graphics_timeline,transfer_timeline};
+        if(async_compute){
+            compute_timeline=std::make_shared<Timeline>(vulkan->device,vulkan->allocator);
+            queue_timelines.push_back(compute_timeline);
+        }
+        vulkan->deletion_queue=std::make_shared<DeletionQueue>(queue_timelines);
+    }
+    if(!options.headless){
+        swapchain_image_fences.resize(window->swapchain_images.size(),VK_NULL_HANDLE);
+    }
+
+    if(options.gpu_profiling){
+        vulkan->gpu_profiler=std::make_shared<GpuProfiler>(
             vulkan->device,
-            vk_render_pass,
-            vulkan->allocator
+            vulkan->allocator,
+            vulkan->physical_device,
+            vk_graphics_queue_family_index,
+            options.frames_in_flight
         );
+        if(async_compute){
+            compute_profiler=std::make_shared<GpuProfiler>(
+                vulkan->device,
+                vulkan->allocator,
+                vulkan->physical_device,
+                vk_compute_queue_family_index,
+                options.frames_in_flight
+            );
+        }
+    }
 
-        vulkan.reset();
+    // simulation resources are accessed from the graphics, transfer and async compute queues, see VulkanContext::sharing_mode
+    vulkan->resource_queue_family_indices={vk_graphics_queue_family_index};
+    if(vk_transfer_queue_family_index!=vk_graphics_queue_family_index){
+        vulkan->resource_queue_family_indices.push_back(vk_transfer_queue_family_index);
+    }
+    if(async_compute){
+        vulkan->resource_queue_family_indices.push_back(vk_compute_queue_family_index);
     }
 
-    #ifdef VK_USE_PLATFORM_XCB_KHR
-    xcb_disconnect(
-        xcb_connection
+    if(options.simulation_backend==SimulationBackend::Cpu){
+        // every frame in flight holds a trail map upload
+        VkDeviceSize trail_map_upload_size=static_cast<VkDeviceSize>(options.simulation.trail_width+16)*options.simulation.trail_height*sizeof(float);
+        this->options.staging_ring_size=std::max(options.staging_ring_size,trail_map_upload_size*(options.frames_in_flight+1));
+    }
+    staging_ring=std::make_shared<StagingRing>(vulkan,this->options.staging_ring_size);
+
+    simulation=std::make_shared<SlimeSimulation>(
+        vulkan,
+        vk_graphics_queue,
+        vk_graphics_queue_family_index,
+        options.simulation
     );
-    #endif
-}
 
-void Application::run_forever(){
-    vulkan->deviceWaitIdle();
-    
-    while(should_keep_running){
-        std::this_thread::sleep_for(std::chrono::milliseconds(33));
+    if(options.simulation_backend==SimulationBackend::Cpu){
+        cpu_simulation=std::make_shared<CpuSlimeSimulation>(options.simulation,options.cpu_simulation_threads);
+        std::cout<<"running the simulation on "<<cpu_simulation->num_threads()<<" cpu threads"<<std::endl;
+    }
+    if(async_compute){
+        std::cout<<"running the simulation on async compute queue family "<<vk_compute_queue_family_index<<std::endl;
+    }
 
-        run_step();
+    // the commands of a step only depend on the trail image it starts from, so they are recorded once
+    if(!cpu_simulation){
+        auto step_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            nullptr,
+            async_compute?compute_vk_command_pool:graphics_vk_command_pool,
+            VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            2
+        };
+        step_command_buffers.resize(step_command_buffer_allocate_info.commandBufferCount);
+        res=vkAllocateCommandBuffers(vulkan->device,&step_command_buffer_allocate_info,step_command_buffers.data());
+        VulkanError::check(VulkanErrorContext::AllocateCommandBuffers,res);
+        simulation->prerecord_steps(step_command_buffers.data());
     }
-}
 
-void Application::run_step(){
-    auto graphics_vk_command_buffer=graphics_command_buffers[0];
+    agent_spawn_random.seed(simulation->parameters.seed);
 
-    auto input_events=window->get_latest_events();
-    for(auto event:input_events){
-        if(const WindowCloseEvent* window_close_event=std::get_if<WindowCloseEvent>(&event.event_variant)){
-            should_keep_running=false;
-        }else if(const PointerMoved* pointer_moved_event=std::get_if<PointerMoved>(&event.event_variant)){
-            ;
-        }else if(const WindowResizeEvent* window_resize_event=std::get_if<WindowResizeEvent>(&event.event_variant)){
-            should_resize_window=true;
-        }
-    }
+    graphics_pipeline=std::make_shared<GraphicsPipeline>(
+        vulkan,
+        vk_render_pass,
+        std::vector<VkDescriptorSetLayout>{simulation->render_descriptor_set_layout}
+    );
+    record_render_commands();
 
-    if(should_resize_window){
-        window->vulkan_resize(vk_render_pass);
+    // modules are only needed during pipeline creation
+    vulkan->shader_registry->clear();
 
-        should_resize_window=false;
-    }
+    vulkan->memory_allocator->print_stats();
 
-    uint32_t next_swapchain_image_index=0;
-    auto res=vkAcquireNextImageKHR(vulkan->device,window->vk_swapchain,0,vk_image_available_semaphore->handle,VK_NULL_HANDLE,&next_swapchain_image_index);
-    if(res!=VK_SUCCESS){
-        switch(res){
-            case VK_SUBOPTIMAL_KHR:
-                should_resize_window=true;
-                break;
-            default:
-                throw VulkanError(VulkanErrorContext::SwapchainAcquireNextImage,res);
-        }
+    // all pipelines exist at this point, save now so that the next launch benefits even if this one does not exit cleanly
+    if(vulkan->pipeline_cache){
+        vulkan->pipeline_cache->save();
+        vulkan->pipeline_cache->print_stats();
     }
-    VkImage current_swapchain_image=window->swapchain_images[next_swapchain_image_index];
+}
+
+Application::~Application(){
+    if(vulkan->device!=VK_NULL_HANDLE){
+        vulkan->deviceWaitIdle();
+        // deferred destructions may free command buffers from the pools below
+        if(vulkan->deletion_queue){
+            vulkan->deletion_queue->flush();
+        }
+
+        for(const auto &commands:render_commands){
+            vkFreeCommandBuffers(vulkan->device,graphics_vk_command_pool,2,commands.draw_command_buffers);
+        }
+        if(!step_command_buffers.empty()){
+            vkFreeCommandBuffers(vulkan->device,async_compute?compute_vk_command_pool:graphics_vk_command_pool,step_command_buffers.size(),step_command_buffers.data());
+        }
+
+        if(!options.headless){
+            vkFreeCommandBuffers(vulkan->device,present_vk_command_pool,present_command_buffers.size(),present_command_buffers.data());
+            vkDestroyCommandPool(vulkan->device,present_vk_command_pool,vulkan->allocator);
+        }
+        vkFreeCommandBuffers(vulkan->device,graphics_vk_command_pool,graphics_command_buffers.size(),graphics_command_buffers.data());
+        vkDestroyCommandPool(vulkan->device,graphics_vk_command_pool,vulkan->allocator);
+        vkFreeCommandBuffers(vulkan->device,transfer_vk_command_pool,transfer_command_buffers.size(),transfer_command_buffers.data());
+        vkDestroyCommandPool(vulkan->device,transfer_vk_command_pool,vulkan->allocator);
+        if(async_compute){
+            vkFreeCommandBuffers(vulkan->device,compute_vk_command_pool,compute_command_buffers.size(),compute_command_buffers.data());
+            vkDestroyCommandPool(vulkan->device,compute_vk_command_pool,vulkan->allocator);
+        }
+
+        // runs outstanding readback callbacks, so must go before the fences
+        staging_ring.reset();
+
+        frames.clear();
+        graphics_timeline.reset();
+        transfer_timeline.reset();
+        compute_timeline.reset();
+        compute_profiler.reset();
+
+        graphics_pipeline.reset();
+        simulation.reset();
+        cpu_simulation.reset();
+
+        window.reset();
+
+        if(options.headless){
+            vkDestroyFramebuffer(vulkan->device,offscreen_framebuffer,vulkan->allocator);
+            vulkan->destroy_image(offscreen_image,offscreen_image_memory,offscreen_image_view);
+        }
+
+        vkDestroyRenderPass(
+            vulkan->device,
+            vk_render_pass,
+            vulkan->allocator
+        );
+
+        vulkan.reset();
+    }
+
+    #ifdef VK_USE_PLATFORM_XCB_KHR
+    if(xcb_connection){
+        xcb_disconnect(
+            xcb_connection
+        );
+    }
+    #endif
+}
+
+void Application::wait_for_next_frame(){
+    std::this_thread::sleep_until(next_frame_time);
+    advance_next_frame_time();
+}
+
+void Application::advance_next_frame_time(){
+    auto frame_duration=std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0/options.target_fps)
+    );
+
+    auto now=std::chrono::steady_clock::now();
+    next_frame_time+=frame_duration;
+    // do not try to catch up on frames after falling behind, e.g. while the window was being dragged
+    if(next_frame_time<now){
+        next_frame_time=now+frame_duration;
+    }
+}
+
+void Application::run_forever(){
+    vulkan->deviceWaitIdle();
+
+    next_frame_time=std::chrono::steady_clock::now();
+    while(should_keep_running){
+        if(!options.headless && options.wait_for_events){
+            if(!wait_for_frame_or_events()){
+                handle_window_events();
+                continue;
+            }
+        }else if(options.frame_pacing==FramePacing::TargetFps){
+            wait_for_next_frame();
+        }
+
+        auto previous_step_index=step_index();
+        run_step();
+        if(step_index()==previous_step_index){
+            continue;
+        }
+
+        if(options.max_steps>0 && step_index()>=options.max_steps){
+            should_keep_running=false;
+        }
+        if(vulkan->gpu_profiler && options.gpu_profile_report_interval>0 && step_index()%options.gpu_profile_report_interval==0){
+            print_gpu_report();
+        }
+    }
+
+    vulkan->deviceWaitIdle();
+
+    if(vulkan->gpu_profiler){
+        print_gpu_report();
+    }
+}
+
+std::vector<GpuScopeTimings> Application::gpu_timings()const{
+    std::vector<GpuScopeTimings> timings;
+    for(auto profiler:{vulkan->gpu_profiler.get(),compute_profiler.get()}){
+        if(profiler){
+            auto profiler_timings=profiler->timings();
+            timings.insert(timings.end(),profiler_timings.begin(),profiler_timings.end());
+        }
+    }
+    std::sort(timings.begin(),timings.end(),[](const GpuScopeTimings &a,const GpuScopeTimings &b){
+        return a.name<b.name;
+    });
+    return timings;
+}
+
+void Application::reset_gpu_timings(){
+    wait_idle();
+    for(auto profiler:{vulkan->gpu_profiler.get(),compute_profiler.get()}){
+        if(profiler){
+            profiler->reset_history();
+        }
+    }
+}
+
+void Application::print_gpu_report()const{
+    if(!vulkan->gpu_profiler || !vulkan->gpu_profiler->supported()){
+        return;
+    }
+    GpuProfiler::print_timings(gpu_timings());
+}
+
+bool Application::wait_for_frame_or_events(){
+    bool frame_pending=!paused || redraw_requested || should_resize_window;
+    if(!frame_pending){
+        // nothing to simulate or draw until input arrives
+        window->wait_for_events({});
+        return false;
+    }
+    // with vsync or uncapped pacing, frames are throttled by image acquisition and presentation instead
+    if(options.frame_pacing!=FramePacing::TargetFps){
+        return true;
+    }
+    if(std::chrono::steady_clock::now()>=next_frame_time){
+        advance_next_frame_time();
+        return true;
+    }
+    window->wait_for_events(next_frame_time);
+    return false;
+}
+
+void Application::record_render_commands(){
+    // frames in flight may still execute the draws into the previous framebuffers
+    if(!render_commands.empty()){
+        std::vector<VkCommandBuffer> draw_command_buffers;
+        for(const auto &commands:render_commands){
+            draw_command_buffers.insert(draw_command_buffers.end(),commands.draw_command_buffers,commands.draw_command_buffers+2);
+        }
+        vulkan->destroy_when_unused([
+            device=vulkan->device,
+            command_pool=graphics_vk_command_pool,
+            draw_command_buffers
+        ]{
+            vkFreeCommandBuffers(device,command_pool,draw_command_buffers.size(),draw_command_buffers.data());
+        });
+        render_commands.clear();
+    }
+
+    std::vector<VkFramebuffer> framebuffers;
+    VkExtent2D extent;
+    if(options.headless){
+        framebuffers={offscreen_framebuffer};
+        extent=VkExtent2D{
+            options.headless_width,
+            options.headless_height
+        };
+    }else{
+        framebuffers=window->vk_swapchain_framebuffers;
+        extent=VkExtent2D{
+            static_cast<uint32_t>(window->width),
+            static_cast<uint32_t>(window->height)
+        };
+    }
+
+    auto draw_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        nullptr,
+        graphics_vk_command_pool,
+        VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        static_cast<uint32_t>(2*framebuffers.size())
+    };
+    std::vector<VkCommandBuffer> draw_command_buffers(draw_command_buffer_allocate_info.commandBufferCount);
+    auto res=vkAllocateCommandBuffers(vulkan->device,&draw_command_buffer_allocate_info,draw_command_buffers.data());
+    VulkanError::check(VulkanErrorContext::AllocateCommandBuffers,res);
 
+    for(size_t framebuffer_index=0;framebuffer_index<framebuffers.size();framebuffer_index++){
+        RenderCommands commands{
+            framebuffers[framebuffer_index],
+            extent,
+            {draw_command_buffers[2*framebuffer_index],draw_command_buffers[2*framebuffer_index+1]}
+        };
+
+        auto inheritance_info=VkCommandBufferInheritanceInfo{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            nullptr,
+            vk_render_pass,
+            0,
+            commands.framebuffer,
+            VK_FALSE,
+            0,
+            0
+        };
+        // with more than one step per frame, consecutive frames in flight may draw the same trail image
+        auto draw_command_buffer_begin_info=VkCommandBufferBeginInfo{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            nullptr,
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+            &inheritance_info
+        };
+        for(uint32_t trail_index=0;trail_index<2;trail_index++){
+            auto command_buffer=commands.draw_command_buffers[trail_index];
+            vkBeginCommandBuffer(command_buffer,&draw_command_buffer_begin_info);
+            {
+                // dynamic state is not inherited from the primary command buffer
+                auto viewport=VkViewport{
+                    0.0,0.0,
+                    static_cast<float>(extent.width),static_cast<float>(extent.height),
+                    0.0,1.0
+                };
+                vkCmdSetViewport(command_buffer,0,1,&viewport);
+                auto scissor=VkRect2D{
+                    VkOffset2D{0,0},
+                    extent
+                };
+                vkCmdSetScissor(command_buffer,0,1,&scissor);
+
+                vkCmdBindPipeline(command_buffer,VK_PIPELINE_BIND_POINT_GRAPHICS,graphics_pipeline->handle);
+                auto render_descriptor_set=simulation->render_descriptor_set(trail_index);
+                vkCmdBindDescriptorSets(
+                    command_buffer,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    graphics_pipeline->layout,
+                    0,
+                    1,
+                    &render_descriptor_set,
+                    0,
+                    nullptr
+                );
+                // fullscreen triangle, vertex positions are generated in the vertex shader
+                vkCmdDraw(command_buffer,3,1,0,0);
+            }
+            discard vkEndCommandBuffer(command_buffer);
+        }
+
+        render_commands.push_back(commands);
+    }
+}
+
+void Application::record_frame(
+    VkCommandBuffer command_buffer,
+    uint32_t num_steps,
+    const RenderCommands *render,
+    VkImage present_image
+){
     auto graphics_command_buffer_begin_info=VkCommandBufferBeginInfo{
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         nullptr,
         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
         nullptr,
     };
-    vkBeginCommandBuffer(graphics_vk_command_buffer,&graphics_command_buffer_begin_info);
+    vkBeginCommandBuffer(command_buffer,&graphics_command_buffer_begin_info);
     {
-        VkClearValue clear_value;
-        clear_value.color.float32[0]=1.0;
-        clear_value.color.float32[1]=1.0;
-        clear_value.color.float32[2]=1.0;
-        clear_value.color.float32[3]=1.0;
-
-        auto render_pass_begin_info=VkRenderPassBeginInfo{
-            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            nullptr,
-            vk_render_pass,
-            window->vk_swapchain_framebuffers[next_swapchain_image_index],
-            VkRect2D{
-                VkOffset2D{
-                    0,
-                    0
+        if(vulkan->gpu_profiler){
+            vulkan->gpu_profiler->begin_frame(current_frame,command_buffer);
+        }
+        GpuProfileScope frame_scope(vulkan->gpu_profiler.get(),command_buffer,"frame");
+
+        // the cpu simulation has already been stepped and uploaded
+        if(!cpu_simulation){
+            simulation->record_steps(command_buffer,vulkan->gpu_profiler.get(),num_steps);
+        }
+
+        if(render){
+            GpuProfileScope render_scope(vulkan->gpu_profiler.get(),command_buffer,"render");
+
+            VkClearValue clear_value;
+            clear_value.color.float32[0]=1.0;
+            clear_value.color.float32[1]=1.0;
+            clear_value.color.float32[2]=1.0;
+            clear_value.color.float32[3]=1.0;
+
+            auto render_pass_begin_info=VkRenderPassBeginInfo{
+                VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                nullptr,
+                vk_render_pass,
+                render->framebuffer,
+                VkRect2D{
+                    VkOffset2D{
+                        0,
+                        0
+                    },
+                    render->extent
                 },
-                VkExtent2D{
-                    static_cast<uint32_t>(window->width),
-                    static_cast<uint32_t>(window->height)
+                1,
+                &clear_value
+            };
+            vkCmdBeginRenderPass(
+                command_buffer,
+                &render_pass_begin_info,
+                VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+            );
+            vkCmdExecuteCommands(command_buffer,1,&render->draw_command_buffers[simulation->trail_index()]);
+            vkCmdEndRenderPass(command_buffer);
+        }
+
+        if(present_image!=VK_NULL_HANDLE){
+            GpuProfileScope present_barrier_scope(vulkan->gpu_profiler.get(),command_buffer,"present_barrier");
+            auto render_image_to_memory_barrier=VkImageMemoryBarrier{
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                nullptr,
+                VK_ACCESS_MEMORY_READ_BIT,
+                VK_ACCESS_MEMORY_READ_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                present_image,
+                VkImageSubresourceRange{
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    0,
+                    1,
+                    0,
+                    1,
                 }
+            };
+            vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0,
+                0,
+                nullptr,
+                0,
+                nullptr,
+                1,
+                &render_image_to_memory_barrier
+            );
+        }
+    }
+    discard vkEndCommandBuffer(command_buffer);
+
+}
+
+void Application::spawn_agents_at_pointer(){
+    if(!window || window->width==0 || window->height==0){
+        return;
+    }
+
+    // the trail map is stretched over the whole window
+    float trail_x=pointer_x/static_cast<float>(window->width)*static_cast<float>(simulation->parameters.trail_width);
+    float trail_y=pointer_y/static_cast<float>(window->height)*static_cast<float>(simulation->parameters.trail_height);
+
+    std::uniform_real_distribution<float> angle_distribution(0.0f,6.2831853f);
+    std::uniform_real_distribution<float> offset_distribution(-4.0f,4.0f);
+    for(uint32_t i=0;i<options.agents_per_click;i++){
+        pending_agent_spawns.push_back(Agent{
+            {
+                trail_x+offset_distribution(agent_spawn_random),
+                trail_y+offset_distribution(agent_spawn_random)
             },
+            angle_distribution(agent_spawn_random),
+            0.0f
+        });
+    }
+}
+
+void Application::write_trail_map(uint64_t step,const Field2D &trail_map)const{
+    auto path=options.trail_readback_directory+"/trail_"+std::to_string(step)+".pfm";
+    std::ofstream file(path,std::ios::binary);
+    if(!file){
+        std::cerr<<"failed to write trail map to "<<path<<std::endl;
+        return;
+    }
+
+    // greyscale pfm, negative scale means little endian, rows are stored bottom to top
+    file<<"Pf\n"<<trail_map.width()<<" "<<trail_map.height()<<"\n-1.0\n";
+    for(size_t row=trail_map.height();row>0;row--){
+        file.write(reinterpret_cast<const char*>(trail_map.row(row-1)),trail_map.width()*sizeof(float));
+    }
+}
+
+void Application::wait_for_frame_transfers(FrameResources &frame){
+    if(!frame.transfer_submitted){
+        return;
+    }
+
+    staging_ring->retire(frame.transfer_fence->handle);
+    frame.transfer_fence->reset();
+    frame.transfer_submitted=false;
+}
+
+uint32_t Application::steps_this_frame()const{
+    if(paused){
+        return 0;
+    }
+
+    uint64_t step=step_index();
+    uint64_t num_steps=std::max<uint32_t>(options.steps_per_frame,1);
+    // stop at the next step that something happens at, like it would when single stepping
+    for(uint64_t interval:{options.trail_readback_interval,options.gpu_profile_report_interval}){
+        if(interval>0){
+            num_steps=std::min(num_steps,interval-step%interval);
+        }
+    }
+    if(options.max_steps>step){
+        num_steps=std::min(num_steps,options.max_steps-step);
+    }
+    return static_cast<uint32_t>(num_steps);
+}
+
+void Application::step_cpu_simulation(uint32_t num_steps){
+    if(num_steps==0){
+        return;
+    }
+    if(!pending_agent_spawns.empty()){
+        cpu_simulation->spawn_agents(agent_spawn_cursor,pending_agent_spawns);
+        agent_spawn_cursor=static_cast<uint32_t>((agent_spawn_cursor+pending_agent_spawns.size())%cpu_simulation->parameters.num_agents);
+        pending_agent_spawns.clear();
+    }
+    for(uint32_t step=0;step<num_steps;step++){
+        cpu_simulation->step();
+    }
+}
+
+void Application::record_uploads(FrameResources &frame){
+    // the trail map is only needed on the gpu to draw it, readbacks are served from the cpu
+    bool upload_trail_map=cpu_simulation && !paused && (!options.headless || options.headless_render);
+    // spawned agents wait while paused, the next step reads them
+    bool upload_agents=!cpu_simulation && !paused && !pending_agent_spawns.empty();
+    frame.upload_recorded=upload_trail_map || upload_agents;
+    if(!frame.upload_recorded){
+        return;
+    }
+
+    // steps of other frames still in flight may be reading the agents that are about to be overwritten, and earlier
+    // draws the trail image, the upload submission waits for them, see submit_frame.
+    // without timeline semaphores only the frame that last drew the trail image is waited for here.
+    // a frame that was not drawn since is the current one, whose slot is already free
+    if(upload_trail_map && !timeline_semaphores){
+        uint32_t last_draw_frame=last_draw_frame_of_trail_image[1-simulation->trail_index()];
+        if(last_draw_frame<frames.size() && &frames[last_draw_frame]!=&frame){
+            frames[last_draw_frame].in_flight_fence->wait();
+        }
+    }
+
+    auto transfer_command_buffer_begin_info=VkCommandBufferBeginInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        nullptr,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        nullptr,
+    };
+    vkBeginCommandBuffer(frame.upload_command_buffer,&transfer_command_buffer_begin_info);
+    if(upload_trail_map){
+        simulation->record_trail_upload(frame.upload_command_buffer,*staging_ring,cpu_simulation->trail_map());
+    }else{
+        simulation->record_agent_upload(frame.upload_command_buffer,*staging_ring,agent_spawn_cursor,pending_agent_spawns);
+        agent_spawn_cursor=static_cast<uint32_t>((agent_spawn_cursor+pending_agent_spawns.size())%simulation->parameters.num_agents);
+        pending_agent_spawns.clear();
+    }
+    discard vkEndCommandBuffer(frame.upload_command_buffer);
+}
+
+void Application::record_compute_steps(FrameResources &frame,uint32_t num_steps){
+    if(num_steps==0){
+        return;
+    }
+
+    auto compute_command_buffer_begin_info=VkCommandBufferBeginInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        nullptr,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        nullptr,
+    };
+    vkBeginCommandBuffer(frame.compute_command_buffer,&compute_command_buffer_begin_info);
+    if(compute_profiler){
+        compute_profiler->begin_frame(current_frame,frame.compute_command_buffer);
+    }
+    simulation->record_steps(frame.compute_command_buffer,compute_profiler.get(),num_steps,false);
+    discard vkEndCommandBuffer(frame.compute_command_buffer);
+
+    frame.compute_steps=num_steps;
+}
+
+void Application::submit_frame(
+    FrameResources &frame,
+    std::vector<VkSemaphore> wait_semaphores,
+    std::vector<VkPipelineStageFlags> wait_stages,
+    std::vector<VkSemaphore> signal_semaphores
+){
+    auto transfer_command_buffer_begin_info=VkCommandBufferBeginInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        nullptr,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        nullptr,
+    };
+
+    bool upload=frame.upload_recorded;
+    frame.upload_recorded=false;
+    uint32_t compute_steps=frame.compute_steps;
+    frame.compute_steps=0;
+    bool compute=compute_steps>0;
+    // the steps recorded for this frame have already advanced step_index
+    bool readback=!paused && options.trail_readback_interval>0 && step_index()%options.trail_readback_interval==0;
+    if(readback && cpu_simulation){
+        write_trail_map(step_index(),cpu_simulation->trail_map());
+        readback=false;
+    }
+
+    // semaphores waited on by the step on the async compute queue, instead of by the graphics submission
+    std::vector<VkSemaphore> step_wait_semaphores;
+
+    if(upload){
+        // agents about to be overwritten may still be read by steps submitted earlier, an uploaded trail map
+        // replaces the image that became current with the upload, which earlier draws may still be sampling
+        VkSemaphore upload_wait_semaphore=VK_NULL_HANDLE;
+        uint64_t upload_wait_value=0;
+        const VkPipelineStageFlags upload_wait_stage=VK_PIPELINE_STAGE_TRANSFER_BIT;
+        if(cpu_simulation){
+            if(timeline_semaphores){
+                upload_wait_semaphore=graphics_timeline->handle;
+                upload_wait_value=last_draw_of_trail_image[simulation->trail_index()];
+            }
+        }else if(async_compute){
+            upload_wait_semaphore=compute_timeline->handle;
+            upload_wait_value=compute_timeline->last_submitted();
+        }else if(timeline_semaphores){
+            upload_wait_semaphore=graphics_timeline->handle;
+            upload_wait_value=last_graphics_steps_value;
+        }else if(pending_steps_semaphore!=VK_NULL_HANDLE){
+            upload_wait_semaphore=pending_steps_semaphore;
+            pending_steps_semaphore=VK_NULL_HANDLE;
+        }
+        uint32_t num_upload_wait_semaphores=upload_wait_semaphore!=VK_NULL_HANDLE?1:0;
+
+        VkSemaphore upload_signal_semaphores[2]={frame.upload_finished_semaphore->handle,VK_NULL_HANDLE};
+        uint64_t upload_signal_values[2]={0,0};
+        auto upload_timeline_submit_info=VkTimelineSemaphoreSubmitInfo{
+            VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            nullptr,
+            num_upload_wait_semaphores,
+            &upload_wait_value,
+            2,
+            upload_signal_values
+        };
+        if(timeline_semaphores){
+            upload_signal_semaphores[1]=transfer_timeline->handle;
+            upload_signal_values[1]=transfer_timeline->next();
+        }
+        auto upload_submit_info=VkSubmitInfo{
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            timeline_semaphores?&upload_timeline_submit_info:nullptr,
+            num_upload_wait_semaphores,
+            &upload_wait_semaphore,
+            &upload_wait_stage,
             1,
-            &clear_value
+            &frame.upload_command_buffer,
+            timeline_semaphores?2u:1u,
+            upload_signal_semaphores
         };
-        vkCmdBeginRenderPass(
-            graphics_vk_command_buffer,
-            &render_pass_begin_info,
-            VK_SUBPASS_CONTENTS_INLINE
-        );
-        {
-            // todo render logic
+        auto res=vkQueueSubmit(vk_transfer_queue,1,&upload_submit_info,readback?VK_NULL_HANDLE:frame.transfer_fence->handle);
+        VulkanError::check(VulkanErrorContext::QueueSubmit,res);
+
+        // agents are read by the step, an uploaded trail map by the draw
+        if(compute){
+            step_wait_semaphores.push_back(frame.upload_finished_semaphore->handle);
+        }else{
+            wait_semaphores.push_back(frame.upload_finished_semaphore->handle);
+            wait_stages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+    }
 
-            
+    // the previous readback reads the trail map that the steps of this frame overwrite if there are several
+    if(pending_readback_semaphore!=VK_NULL_HANDLE){
+        if(compute){
+            step_wait_semaphores.push_back(pending_readback_semaphore);
+        }else{
+            wait_semaphores.push_back(pending_readback_semaphore);
+            wait_stages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
         }
-        vkCmdEndRenderPass(graphics_vk_command_buffer);
+        pending_readback_semaphore=VK_NULL_HANDLE;
+    }
+
+    // not waited on by an upload, but a binary semaphore must be waited on before it can be signaled again
+    if(pending_steps_semaphore!=VK_NULL_HANDLE){
+        wait_semaphores.push_back(pending_steps_semaphore);
+        wait_stages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        pending_steps_semaphore=VK_NULL_HANDLE;
+    }
 
-        auto render_image_to_memory_barrier=VkImageMemoryBarrier{
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    // timeline values of all semaphores waited on and signaled by the graphics submission, ignored for binary semaphores
+    std::vector<uint64_t> wait_values(wait_semaphores.size(),0);
+    std::vector<uint64_t> signal_values(signal_semaphores.size(),0);
+    if(compute){
+        // a single step only reads the latest trail image, which earlier draws may still be sampling, and writes the
+        // other one, which was drawn two steps before. several steps write both
+        step_wait_semaphores.push_back(graphics_timeline->handle);
+        std::vector<uint64_t> step_wait_values(step_wait_semaphores.size(),0);
+        step_wait_values.back()=compute_steps==1
+            ?last_render_of_step_parity[step_index()%2]
+            :std::max(last_render_of_step_parity[0],last_render_of_step_parity[1]);
+        std::vector<VkPipelineStageFlags> step_wait_stages(step_wait_semaphores.size(),VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        uint64_t step_value=compute_timeline->next();
+
+        auto step_timeline_submit_info=VkTimelineSemaphoreSubmitInfo{
+            VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
             nullptr,
-            VK_ACCESS_MEMORY_READ_BIT,
-            VK_ACCESS_MEMORY_READ_BIT,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-            VK_QUEUE_FAMILY_IGNORED,
-            VK_QUEUE_FAMILY_IGNORED,
-            current_swapchain_image,
-            VkImageSubresourceRange{
-                VK_IMAGE_ASPECT_COLOR_BIT,
-                0,
-                1,
-                0,
-                1,
-            }
+            static_cast<uint32_t>(step_wait_values.size()),
+            step_wait_values.data(),
+            1,
+            &step_value
         };
-        vkCmdPipelineBarrier(
-            graphics_vk_command_buffer,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
+        auto step_submit_info=VkSubmitInfo{
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            &step_timeline_submit_info,
+            static_cast<uint32_t>(step_wait_semaphores.size()),
+            step_wait_semaphores.data(),
+            step_wait_stages.data(),
             1,
-            &render_image_to_memory_barrier
-        );
+            &frame.compute_command_buffer,
+            1,
+            &compute_timeline->handle
+        };
+        auto res=vkQueueSubmit(vk_compute_queue,1,&step_submit_info,VK_NULL_HANDLE);
+        VulkanError::check(VulkanErrorContext::QueueSubmit,res);
     }
-    //discard vkEndCommandBuffer(present_vk_command_buffer);
-    discard vkEndCommandBuffer(graphics_vk_command_buffer);
+    if(async_compute){
+        // draw the result of the latest step, which may have been submitted by an earlier frame if paused
+        wait_semaphores.push_back(compute_timeline->handle);
+        wait_stages.push_back(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        wait_values.push_back(compute_timeline->last_submitted());
+    }
+    if(timeline_semaphores){
+        signal_semaphores.push_back(graphics_timeline->handle);
+        signal_values.push_back(graphics_timeline->next());
+        last_render_of_step_parity[step_index()%2]=signal_values.back();
+        last_draw_of_trail_image[simulation->trail_index()]=signal_values.back();
+        if(frame.graphics_steps>0){
+            last_graphics_steps_value=signal_values.back();
+        }
+    }else if(frame.graphics_steps>0){
+        signal_semaphores.push_back(frame.steps_finished_semaphore->handle);
+        signal_values.push_back(0);
+        pending_steps_semaphore=frame.steps_finished_semaphore->handle;
+    }
+    frame.graphics_steps=0;
 
-    const VkPipelineStageFlags wait_dst_stage_mask=VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    std::vector<VkCommandBuffer> submit_command_buffers{
-        graphics_vk_command_buffer
+    if(readback){
+        signal_semaphores.push_back(frame.readback_ready_semaphore->handle);
+        signal_values.push_back(0);
+    }
+
+    // timeline values may only be attached if timeline semaphores are enabled
+    auto graphics_timeline_submit_info=VkTimelineSemaphoreSubmitInfo{
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        nullptr,
+        static_cast<uint32_t>(wait_values.size()),
+        wait_values.data(),
+        static_cast<uint32_t>(signal_values.size()),
+        signal_values.data()
     };
-    std::vector<VkSubmitInfo> graphics_queue_submit_infos{
-        VkSubmitInfo{
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    auto graphics_submit_info=VkSubmitInfo{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        timeline_semaphores?&graphics_timeline_submit_info:nullptr,
+        static_cast<uint32_t>(wait_semaphores.size()),
+        wait_semaphores.data(),
+        wait_stages.data(),
+        1,
+        &frame.command_buffer,
+        static_cast<uint32_t>(signal_semaphores.size()),
+        signal_semaphores.data()
+    };
+    auto res=vkQueueSubmit(vk_graphics_queue,1,&graphics_submit_info,frame.in_flight_fence->handle);
+    VulkanError::check(VulkanErrorContext::QueueSubmit,res);
+    last_draw_frame_of_trail_image[simulation->trail_index()]=current_frame;
+
+    if(readback){
+        vkBeginCommandBuffer(frame.readback_command_buffer,&transfer_command_buffer_begin_info);
+        auto step=step_index();
+        simulation->record_trail_readback(
+            frame.readback_command_buffer,
+            *staging_ring,
+            [this,step](const Field2D &trail_map){
+                write_trail_map(step,trail_map);
+            }
+        );
+        discard vkEndCommandBuffer(frame.readback_command_buffer);
+
+        const VkPipelineStageFlags readback_wait_stage=VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSemaphore readback_signal_semaphores[2]={frame.readback_finished_semaphore->handle,VK_NULL_HANDLE};
+        uint64_t readback_wait_value=0;
+        uint64_t readback_signal_values[2]={0,0};
+        auto readback_timeline_submit_info=VkTimelineSemaphoreSubmitInfo{
+            VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
             nullptr,
             1,
-            &vk_image_available_semaphore->handle,
-            &wait_dst_stage_mask,
-            static_cast<uint32_t>(submit_command_buffers.size()),
-            submit_command_buffers.data(),
-            1,
-            &vk_rendering_finished_semaphore->handle
+            &readback_wait_value,
+            2,
+            readback_signal_values
+        };
+        if(timeline_semaphores){
+            readback_signal_semaphores[1]=transfer_timeline->handle;
+            readback_signal_values[1]=transfer_timeline->next();
         }
-    };
-    vkQueueSubmit(
-        vk_graphics_queue,
-        static_cast<uint32_t>(graphics_queue_submit_infos.size()),
-        graphics_queue_submit_infos.data(),
+        auto readback_submit_info=VkSubmitInfo{
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            timeline_semaphores?&readback_timeline_submit_info:nullptr,
+            1,
+            &frame.readback_ready_semaphore->handle,
+            &readback_wait_stage,
+            1,
+            &frame.readback_command_buffer,
+            timeline_semaphores?2u:1u,
+            readback_signal_semaphores
+        };
+        res=vkQueueSubmit(vk_transfer_queue,1,&readback_submit_info,frame.transfer_fence->handle);
+        VulkanError::check(VulkanErrorContext::QueueSubmit,res);
+
+        pending_readback_semaphore=frame.readback_finished_semaphore->handle;
+    }
+
+    if(upload || readback){
+        staging_ring->submitted(frame.transfer_fence->handle);
+        frame.transfer_submitted=true;
+    }
+}
+
+void Application::run_headless_step(){
+    auto &frame=frames[current_frame];
+
+    if(vulkan->deletion_queue){
+        vulkan->deletion_queue->collect();
+    }
+
+    uint32_t num_steps=steps_this_frame();
+
+    // overlaps with the gpu work of frames still in flight
+    if(cpu_simulation){
+        step_cpu_simulation(num_steps);
+    }
+
+    // wait until the gpu is done with the resources of this frame slot, other frames may still be in flight
+    frame.in_flight_fence->wait();
+    frame.in_flight_fence->reset();
+    wait_for_frame_transfers(frame);
+    record_uploads(frame);
+    if(async_compute){
+        record_compute_steps(frame,num_steps);
+    }
+
+    record_frame(
+        frame.command_buffer,
+        async_compute?0:num_steps,
+        options.headless_render?&render_commands[0]:nullptr,
         VK_NULL_HANDLE
     );
+    frame.graphics_steps=async_compute || cpu_simulation?0:num_steps;
+
+    submit_frame(frame,{},{},{});
+
+    current_frame=(current_frame+1)%frames.size();
+}
+
+void Application::handle_window_events(){
+    for(const auto &event:window->get_latest_events()){
+        if(const WindowCloseEvent* window_close_event=std::get_if<WindowCloseEvent>(&event.event_variant)){
+            should_keep_running=false;
+        }else if(const PointerMoved* pointer_moved_event=std::get_if<PointerMoved>(&event.event_variant)){
+            pointer_x=pointer_moved_event->x;
+            pointer_y=pointer_moved_event->y;
+        }else if(const ButtonPressed* button_pressed_event=std::get_if<ButtonPressed>(&event.event_variant)){
+            if(button_pressed_event->button==1){
+                spawn_agents_at_pointer();
+            }
+        }else if(const KeyPressed* key_pressed_event=std::get_if<KeyPressed>(&event.event_variant)){
+            if(key_pressed_event->key==PAUSE_KEY){
+                paused=!paused;
+                std::cout<<(paused?"paused":"resumed")<<" at step "<<step_index()<<std::endl;
+            }
+        }else if(const WindowResizeEvent* window_resize_event=std::get_if<WindowResizeEvent>(&event.event_variant)){
+            should_resize_window=true;
+        }else if(std::holds_alternative<WindowExposeEvent>(event.event_variant)){
+            redraw_requested=true;
+        }
+    }
+}
+
+void Application::run_step(){
+    if(options.headless){
+        run_headless_step();
+        return;
+    }
+
+    auto &frame=frames[current_frame];
+    auto graphics_vk_command_buffer=frame.command_buffer;
+
+    if(vulkan->deletion_queue){
+        vulkan->deletion_queue->collect();
+    }
+
+    handle_window_events();
+
+    if(should_resize_window){
+        window->vulkan_resize(vk_render_pass);
+        record_render_commands();
+        swapchain_image_fences.assign(window->swapchain_images.size(),VK_NULL_HANDLE);
+
+        should_resize_window=false;
+    }
+
+    uint32_t num_steps=steps_this_frame();
+
+    // overlaps with the gpu work of frames still in flight
+    if(cpu_simulation){
+        step_cpu_simulation(num_steps);
+    }
+
+    // wait until the gpu is done with the resources of this frame slot, other frames may still be in flight
+    frame.in_flight_fence->wait();
+
+    uint32_t next_swapchain_image_index=0;
+    auto res=vkAcquireNextImageKHR(vulkan->device,window->vk_swapchain,UINT64_MAX,frame.image_available_semaphore->handle,VK_NULL_HANDLE,&next_swapchain_image_index);
+    switch(res){
+        case VK_SUCCESS:
+            break;
+        case VK_SUBOPTIMAL_KHR:
+            // image was still acquired and can be rendered to
+            should_resize_window=true;
+            break;
+        case VK_ERROR_OUT_OF_DATE_KHR:
+            // no image was acquired, retry after the swapchain has been recreated
+            should_resize_window=true;
+            return;
+        default:
+            throw VulkanError(VulkanErrorContext::SwapchainAcquireNextImage,res);
+    }
+    VkImage current_swapchain_image=window->swapchain_images[next_swapchain_image_index];
+
+    // another frame slot may still be rendering into the same swapchain image (if there are more frames in flight than swapchain images)
+    VkFence swapchain_image_fence=swapchain_image_fences[next_swapchain_image_index];
+    if(swapchain_image_fence!=VK_NULL_HANDLE && swapchain_image_fence!=frame.in_flight_fence->handle){
+        vkWaitForFences(vulkan->device,1,&swapchain_image_fence,VK_TRUE,UINT64_MAX);
+    }
+    swapchain_image_fences[next_swapchain_image_index]=frame.in_flight_fence->handle;
+
+    // only reset once work is guaranteed to be submitted for this frame, otherwise the next wait would deadlock
+    frame.in_flight_fence->reset();
+    wait_for_frame_transfers(frame);
+    record_uploads(frame);
+    if(async_compute){
+        record_compute_steps(frame,num_steps);
+    }
+
+    record_frame(
+        graphics_vk_command_buffer,
+        async_compute?0:num_steps,
+        &render_commands[next_swapchain_image_index],
+        current_swapchain_image
+    );
+    frame.graphics_steps=async_compute || cpu_simulation?0:num_steps;
+
+    submit_frame(
+        frame,
+        {frame.image_available_semaphore->handle},
+        {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT},
+        {frame.rendering_finished_semaphore->handle}
+    );
 
     std::vector<VkSemaphore> swapchain_present_await_semaphores{
-        vk_rendering_finished_semaphore->handle
+        frame.rendering_finished_semaphore->handle
     };
     auto swapchain_present_info=VkPresentInfoKHR{
         VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -795,7 +1808,18 @@ void Application::run_step(){
         &next_swapchain_image_index,
         nullptr,
     };
-    vkQueuePresentKHR(vk_present_queue,&swapchain_present_info);
+    res=vkQueuePresentKHR(vk_present_queue,&swapchain_present_info);
+    switch(res){
+        case VK_SUCCESS:
+            break;
+        case VK_SUBOPTIMAL_KHR:
+        case VK_ERROR_OUT_OF_DATE_KHR:
+            should_resize_window=true;
+            break;
+        default:
+            throw VulkanError(VulkanErrorContext::QueuePresent,res);
+    }
+    redraw_requested=false;
 
-    vulkan->deviceWaitIdle();
+    current_frame=(current_frame+1)%frames.size();
 }
\ No newline at end of file
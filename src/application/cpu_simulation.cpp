@@ -0,0 +1,182 @@
+#include <application/cpu_simulation.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace{
+    // same constants and hash as slime_common.glsl
+
+    const float PI=3.14159265359f;
+
+    uint32_t hash(uint32_t state){
+        state=state*747796405u+2891336453u;
+        uint32_t word=((state>>((state>>28u)+4u))^state)*277803737u;
+        return (word>>22u)^word;
+    }
+    float random01(uint32_t h){
+        return static_cast<float>(h)/4294967295.0f;
+    }
+}
+
+CpuSlimeSimulation::CpuSlimeSimulation(const SimulationParameters &parameters,size_t num_threads)
+:thread_pool(num_threads),parameters(parameters){
+    agent_x.resize(parameters.num_agents);
+    agent_y.resize(parameters.num_agents);
+    agent_angle.resize(parameters.num_agents);
+
+    trail_maps[0]=Field2D(parameters.trail_width,parameters.trail_height,0.0f);
+    trail_maps[1]=Field2D(parameters.trail_width,parameters.trail_height,0.0f);
+    deposit_counts=std::vector<std::atomic<uint32_t>>(static_cast<size_t>(parameters.trail_width)*parameters.trail_height);
+
+    // slime_init.comp
+    thread_pool.parallel_for(parameters.num_agents,AGENT_GRAIN,[this](size_t begin,size_t end){
+        float width=static_cast<float>(this->parameters.trail_width);
+        float height=static_cast<float>(this->parameters.trail_height);
+        for(size_t id=begin;id<end;id++){
+            uint32_t random=hash(static_cast<uint32_t>(id)^hash(this->parameters.seed));
+            float radius=std::min(width,height)*0.4f*std::sqrt(random01(random));
+            float theta=random01(hash(random))*2.0f*PI;
+
+            agent_x[id]=width*0.5f+std::cos(theta)*radius;
+            agent_y[id]=height*0.5f+std::sin(theta)*radius;
+            agent_angle[id]=theta+PI;
+        }
+    });
+}
+
+void CpuSlimeSimulation::update_agents(size_t begin,size_t end){
+    const Field2D &trail_map=trail_maps[current_trail_index];
+    int32_t max_x=static_cast<int32_t>(parameters.trail_width)-1;
+    int32_t max_y=static_cast<int32_t>(parameters.trail_height)-1;
+    float bound_x=static_cast<float>(parameters.trail_width);
+    float bound_y=static_cast<float>(parameters.trail_height);
+    uint32_t step_random=hash(static_cast<uint32_t>(step_index)^hash(parameters.seed));
+
+    auto sense=[&](float x,float y,float angle){
+        int32_t center_x=static_cast<int32_t>(x+std::cos(angle)*parameters.sensor_distance);
+        int32_t center_y=static_cast<int32_t>(y+std::sin(angle)*parameters.sensor_distance);
+        float sum=0.0f;
+        for(int32_t offset_x=-parameters.sensor_size;offset_x<=parameters.sensor_size;offset_x++){
+            for(int32_t offset_y=-parameters.sensor_size;offset_y<=parameters.sensor_size;offset_y++){
+                sum+=trail_map(
+                    std::clamp(center_x+offset_x,0,max_x),
+                    std::clamp(center_y+offset_y,0,max_y)
+                );
+            }
+        }
+        return sum;
+    };
+
+    for(size_t id=begin;id<end;id++){
+        float x=agent_x[id];
+        float y=agent_y[id];
+        float angle=agent_angle[id];
+
+        uint32_t random=hash(static_cast<uint32_t>(id)^step_random);
+        float steer_strength=random01(random);
+
+        // sense
+        float weight_forward=sense(x,y,angle);
+        float weight_left=sense(x,y,angle+parameters.sensor_angle);
+        float weight_right=sense(x,y,angle-parameters.sensor_angle);
+
+        // rotate
+        if(weight_forward>weight_left && weight_forward>weight_right){
+            ;
+        }else if(weight_forward<weight_left && weight_forward<weight_right){
+            angle+=(steer_strength-0.5f)*2.0f*parameters.turn_speed;
+        }else if(weight_right>weight_left){
+            angle-=steer_strength*parameters.turn_speed;
+        }else if(weight_left>weight_right){
+            angle+=steer_strength*parameters.turn_speed;
+        }
+
+        // move
+        float new_x=x+std::cos(angle)*parameters.move_speed;
+        float new_y=y+std::sin(angle)*parameters.move_speed;
+        if(new_x<0.0f || new_x>=bound_x || new_y<0.0f || new_y>=bound_y){
+            new_x=std::clamp(new_x,0.0f,bound_x-0.01f);
+            new_y=std::clamp(new_y,0.0f,bound_y-0.01f);
+            angle=random01(hash(random))*2.0f*PI;
+        }
+        agent_x[id]=new_x;
+        agent_y[id]=new_y;
+        agent_angle[id]=angle;
+
+        size_t pixel=static_cast<size_t>(new_y)*parameters.trail_width+static_cast<size_t>(new_x);
+        deposit_counts[pixel].fetch_add(1,std::memory_order_relaxed);
+    }
+}
+
+void CpuSlimeSimulation::deposit_rows(size_t begin,size_t end){
+    Field2D &trail_map=trail_maps[1-current_trail_index];
+    for(size_t y=begin;y<end;y++){
+        float *row=trail_map.row(y);
+        auto counts=deposit_counts.data()+y*parameters.trail_width;
+        for(size_t x=0;x<parameters.trail_width;x++){
+            // one saturating add per agent, exactly like the shader
+            uint32_t count=counts[x].exchange(0,std::memory_order_relaxed);
+            for(uint32_t i=0;i<count;i++){
+                row[x]=std::min(1.0f,row[x]+parameters.deposit);
+            }
+        }
+    }
+}
+
+void CpuSlimeSimulation::diffuse_rows(size_t begin,size_t end){
+    const Field2D &trail_map=trail_maps[current_trail_index];
+    Field2D &diffused_trail_map=trail_maps[1-current_trail_index];
+    size_t width=parameters.trail_width;
+    size_t height=parameters.trail_height;
+    float diffuse=parameters.diffuse;
+    float decay=parameters.decay;
+
+    // sums of three rows with the edge columns repeated, so the horizontal pass needs no clamping
+    thread_local std::vector<float> vertical_sums;
+    vertical_sums.resize(width+2);
+
+    for(size_t y=begin;y<end;y++){
+        const float *above=trail_map.row(y>0?y-1:0);
+        const float *center=trail_map.row(y);
+        const float *below=trail_map.row(y+1<height?y+1:height-1);
+
+        float *__restrict sums=vertical_sums.data();
+        matrix_simd::add(sums+1,above,center,width);
+        matrix_simd::add(sums+1,sums+1,below,width);
+        sums[0]=sums[1];
+        sums[width+1]=sums[width];
+
+        float *__restrict diffused=diffused_trail_map.row(y);
+        for(size_t x=0;x<width;x++){
+            float sum=sums[x]+sums[x+1]+sums[x+2];
+            float original=center[x];
+            // mix(original,sum/9.0,diffuse) as specified by glsl
+            float mixed=original*(1.0f-diffuse)+(sum/9.0f)*diffuse;
+            diffused[x]=std::max(0.0f,mixed-decay);
+        }
+    }
+}
+
+void CpuSlimeSimulation::step(){
+    thread_pool.parallel_for(parameters.num_agents,AGENT_GRAIN,[this](size_t begin,size_t end){
+        update_agents(begin,end);
+    });
+    // like slime_diffuse.comp followed by the deposit of slime_agents.comp, rows only depend on their own deposits
+    thread_pool.parallel_for(parameters.trail_height,TILE_ROWS,[this](size_t begin,size_t end){
+        diffuse_rows(begin,end);
+        deposit_rows(begin,end);
+    });
+
+    current_trail_index=1-current_trail_index;
+    step_index++;
+}
+
+void CpuSlimeSimulation::spawn_agents(uint32_t first_agent,const std::vector<Agent> &agents){
+    for(size_t i=0;i<agents.size();i++){
+        size_t id=(first_agent+i)%parameters.num_agents;
+        agent_x[id]=agents[i].position[0];
+        agent_y[id]=agents[i].position[1];
+        agent_angle[id]=agents[i].angle;
+    }
+}
@@ -0,0 +1,49 @@
+#include <application/deletion_queue.h>
+
+DeletionQueue::DeletionQueue(
+    std::vector<std::shared_ptr<Timeline>> timelines
+):timelines(timelines){}
+
+DeletionQueue::~DeletionQueue(){
+    flush();
+}
+
+bool DeletionQueue::retired(const Deletion &deletion)const{
+    for(size_t i=0;i<timelines.size();i++){
+        if(!timelines[i]->reached(deletion.retirement_values[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+void DeletionQueue::defer(std::function<void()> destroy){
+    Deletion deletion{{},std::move(destroy)};
+    deletion.retirement_values.reserve(timelines.size());
+    for(const auto &timeline:timelines){
+        deletion.retirement_values.push_back(timeline->last_submitted());
+    }
+    deletions.push_back(std::move(deletion));
+}
+
+size_t DeletionQueue::collect(){
+    // retirement values never decrease, so the first deletion that has not retired blocks all later ones
+    while(!deletions.empty() && retired(deletions.front())){
+        auto destroy=std::move(deletions.front().destroy);
+        deletions.pop_front();
+        destroy();
+    }
+    return deletions.size();
+}
+
+void DeletionQueue::flush(){
+    while(!deletions.empty()){
+        auto &deletion=deletions.front();
+        for(size_t i=0;i<timelines.size();i++){
+            timelines[i]->wait_until(deletion.retirement_values[i]);
+        }
+        auto destroy=std::move(deletion.destroy);
+        deletions.pop_front();
+        destroy();
+    }
+}
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <application/device_selection.h>
+#include <application/vulkan_error.h>
+
+bool PhysicalDeviceCandidate::supports_extension(const char *extension_name)const{
+    return std::find(extensions.begin(),extensions.end(),extension_name)!=extensions.end();
+}
+
+static const char* device_type_name(VkPhysicalDeviceType device_type){
+    switch(device_type){
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return "DISCRETE_GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return "INTEGRATED_GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return "VIRTUAL_GPU";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return "CPU";
+        case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+            return "DEVICE_TYPE_OTHER";
+        default:
+            return "invalid device type";
+    }
+}
+
+/// base score by device type, a software device should only win if there is nothing else
+static int64_t device_type_score(VkPhysicalDeviceType device_type){
+    switch(device_type){
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return 10000;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return 5000;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return 2500;
+        default:
+            return 0;
+    }
+}
+
+static void choose_queue_families(
+    PhysicalDeviceCandidate &candidate,
+    const std::vector<VkBool32> &supports_presentation
+){
+    for(uint32_t queue_family_index=0;queue_family_index<candidate.queue_families.size();queue_family_index++){
+        auto flags=candidate.queue_families[queue_family_index].queueFlags;
+        bool supports_graphics=(flags&VK_QUEUE_GRAPHICS_BIT)>0;
+        // the simulation is dispatched on the graphics queue
+        bool supports_compute=(flags&VK_QUEUE_COMPUTE_BIT)>0;
+        bool supports_transfer=(flags&VK_QUEUE_TRANSFER_BIT)>0;
+
+        // a family that can also present saves a queue family ownership transfer of the swapchain image
+        if(supports_graphics && supports_compute){
+            bool is_better=candidate.graphics_queue_family_index==UINT32_MAX
+                || (supports_presentation[queue_family_index] && !supports_presentation[candidate.graphics_queue_family_index]);
+            if(is_better){
+                candidate.graphics_queue_family_index=queue_family_index;
+            }
+        }
+        if(supports_compute && !supports_graphics && candidate.dedicated_compute_queue_family_index==UINT32_MAX){
+            candidate.dedicated_compute_queue_family_index=queue_family_index;
+        }
+        // graphics and compute queues implicitly support transfer, even if the bit is not set
+        if(supports_transfer && !supports_graphics && !supports_compute && candidate.dedicated_transfer_queue_family_index==UINT32_MAX){
+            candidate.dedicated_transfer_queue_family_index=queue_family_index;
+        }
+    }
+
+    if(candidate.graphics_queue_family_index!=UINT32_MAX && supports_presentation[candidate.graphics_queue_family_index]){
+        candidate.present_queue_family_index=candidate.graphics_queue_family_index;
+    }else{
+        for(uint32_t queue_family_index=0;queue_family_index<supports_presentation.size();queue_family_index++){
+            if(supports_presentation[queue_family_index]){
+                candidate.present_queue_family_index=queue_family_index;
+                break;
+            }
+        }
+    }
+}
+
+static void score_candidate(
+    PhysicalDeviceCandidate &candidate,
+    bool requires_presentation,
+    const std::vector<const char*> &required_extensions,
+    const DeviceSelectionOptions &options
+){
+    auto device_type=candidate.properties.deviceType;
+    bool is_software=device_type==VK_PHYSICAL_DEVICE_TYPE_CPU || device_type==VK_PHYSICAL_DEVICE_TYPE_OTHER;
+
+    // an explicitly requested device may be a software device without also setting allow_cpu
+    bool has_override=options.device_index.has_value() || !options.device_name.empty();
+    if(is_software && !options.allow_cpu && !has_override){
+        candidate.rejection_reason="software device, not allowed";
+        return;
+    }
+    for(auto required_extension:required_extensions){
+        if(!candidate.supports_extension(required_extension)){
+            candidate.rejection_reason=std::string("missing extension ")+required_extension;
+            return;
+        }
+    }
+    if(candidate.graphics_queue_family_index==UINT32_MAX){
+        candidate.rejection_reason="no queue family supports graphics and compute";
+        return;
+    }
+    if(requires_presentation && candidate.present_queue_family_index==UINT32_MAX){
+        candidate.rejection_reason="no queue family supports presentation";
+        return;
+    }
+
+    candidate.viable=true;
+
+    candidate.score=device_type_score(device_type);
+    // more memory usually means a bigger gpu, 1 point per 64MB keeps this below the device type difference for realistic sizes
+    candidate.score+=static_cast<int64_t>(candidate.device_local_heap_size>>26);
+    if(candidate.dedicated_compute_queue_family_index!=UINT32_MAX){
+        candidate.score+=100;
+    }
+    if(candidate.dedicated_transfer_queue_family_index!=UINT32_MAX){
+        candidate.score+=50;
+    }
+    if(requires_presentation && candidate.present_queue_family_index==candidate.graphics_queue_family_index){
+        candidate.score+=25;
+    }
+}
+
+std::vector<PhysicalDeviceCandidate> enumerate_physical_device_candidates(
+    VkInstance instance,
+    VkSurfaceKHR surface,
+    const std::vector<const char*> &required_extensions,
+    const DeviceSelectionOptions &options
+){
+    uint32_t num_physical_devices=0;
+    vkEnumeratePhysicalDevices(instance,&num_physical_devices,nullptr);
+    std::vector<VkPhysicalDevice> physical_devices(num_physical_devices);
+    vkEnumeratePhysicalDevices(instance,&num_physical_devices,physical_devices.data());
+
+    std::vector<PhysicalDeviceCandidate> candidates;
+    for(uint32_t physical_device_index=0;physical_device_index<num_physical_devices;physical_device_index++){
+        PhysicalDeviceCandidate candidate;
+        candidate.physical_device=physical_devices[physical_device_index];
+        candidate.index=physical_device_index;
+
+        vkGetPhysicalDeviceProperties(candidate.physical_device,&candidate.properties);
+        vkGetPhysicalDeviceMemoryProperties(candidate.physical_device,&candidate.memory_properties);
+
+        for(uint32_t heap_index=0;heap_index<candidate.memory_properties.memoryHeapCount;heap_index++){
+            const auto &heap=candidate.memory_properties.memoryHeaps[heap_index];
+            if((heap.flags&VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size>candidate.device_local_heap_size){
+                candidate.device_local_heap_size=heap.size;
+            }
+        }
+
+        uint32_t num_device_extension_properties=0;
+        vkEnumerateDeviceExtensionProperties(candidate.physical_device,nullptr,&num_device_extension_properties,nullptr);
+        std::vector<VkExtensionProperties> device_extension_properties(num_device_extension_properties);
+        vkEnumerateDeviceExtensionProperties(candidate.physical_device,nullptr,&num_device_extension_properties,device_extension_properties.data());
+        for(const auto &device_extension_property:device_extension_properties){
+            candidate.extensions.push_back(device_extension_property.extensionName);
+        }
+
+        uint32_t num_queue_families=0;
+        vkGetPhysicalDeviceQueueFamilyProperties(candidate.physical_device,&num_queue_families,nullptr);
+        candidate.queue_families.resize(num_queue_families);
+        vkGetPhysicalDeviceQueueFamilyProperties(candidate.physical_device,&num_queue_families,candidate.queue_families.data());
+
+        std::vector<VkBool32> supports_presentation(num_queue_families,VK_FALSE);
+        if(surface!=VK_NULL_HANDLE){
+            for(uint32_t queue_family_index=0;queue_family_index<num_queue_families;queue_family_index++){
+                auto res=vkGetPhysicalDeviceSurfaceSupportKHR(
+                    candidate.physical_device,
+                    queue_family_index,
+                    surface,
+                    &supports_presentation[queue_family_index]
+                );
+                if(res!=VK_SUCCESS){
+                    std::cout<<"failed vkGetPhysicalDeviceSurfaceSupportKHR with "<<res<<std::endl;
+                    throw std::runtime_error("vkGetPhysicalDeviceSurfaceSupportKHR failed");
+                }
+            }
+        }
+
+        choose_queue_families(candidate,supports_presentation);
+        score_candidate(candidate,surface!=VK_NULL_HANDLE,required_extensions,options);
+
+        std::cout<<"device "<<candidate.index<<": "<<candidate.properties.deviceName<<" : "<<device_type_name(candidate.properties.deviceType)<<std::endl;
+        for(uint32_t queue_family_index=0;queue_family_index<num_queue_families;queue_family_index++){
+            std::cout<<"  "<<candidate.queue_families[queue_family_index].queueCount<<" queues allowed of family "<<queue_family_index<<std::endl;
+        }
+        if(candidate.viable){
+            std::cout<<"-- viable device found, score "<<candidate.score<<std::endl;
+        }else{
+            std::cout<<"-- device is not viable: "<<candidate.rejection_reason<<std::endl;
+        }
+
+        candidates.push_back(std::move(candidate));
+    }
+
+    return candidates;
+}
+
+const PhysicalDeviceCandidate& select_physical_device(
+    const std::vector<PhysicalDeviceCandidate> &candidates,
+    const DeviceSelectionOptions &options
+){
+    const PhysicalDeviceCandidate *selected=nullptr;
+
+    bool has_override=options.device_index.has_value() || !options.device_name.empty();
+    if(has_override){
+        for(const auto &candidate:candidates){
+            bool index_matches=options.device_index.has_value() && candidate.index==options.device_index.value();
+            bool name_matches=!options.device_name.empty() && std::strstr(candidate.properties.deviceName,options.device_name.c_str())!=nullptr;
+            if(index_matches || name_matches){
+                selected=&candidate;
+                break;
+            }
+        }
+
+        if(selected==nullptr){
+            std::cout<<"requested device not found"<<std::endl;
+            throw VulkanError(VulkanErrorContext::NoViablePhysicalDeviceFound);
+        }
+        if(!selected->viable){
+            std::cout<<"requested device "<<selected->properties.deviceName<<" is not viable: "<<selected->rejection_reason<<std::endl;
+            throw VulkanError(VulkanErrorContext::NoViablePhysicalDeviceFound);
+        }
+    }else{
+        for(const auto &candidate:candidates){
+            // ties go to the device enumerated first, which is usually the one the driver considers primary
+            if(candidate.viable && (selected==nullptr || candidate.score>selected->score)){
+                selected=&candidate;
+            }
+        }
+
+        if(selected==nullptr){
+            throw VulkanError(VulkanErrorContext::NoViablePhysicalDeviceFound);
+        }
+    }
+
+    std::cout<<"using device "<<selected->index<<": "<<selected->properties.deviceName<<std::endl;
+    return *selected;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include <application/gpu_profiler.h>
+#include <application/vulkan_error.h>
+
+/// query value plus availability, as written with VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+struct TimestampResult{
+    uint64_t timestamp;
+    uint64_t available;
+};
+
+static constexpr uint32_t NO_SCOPE=UINT32_MAX;
+
+GpuProfiler::GpuProfiler(
+    VkDevice device,
+    VkAllocationCallbacks *allocator,
+    VkPhysicalDevice physical_device,
+    uint32_t queue_family_index,
+    uint32_t num_frames,
+    uint32_t max_scopes_per_frame
+):device(device),allocator(allocator),max_scopes_per_frame(max_scopes_per_frame),frames(num_frames){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device,&properties);
+    timestamp_period=properties.limits.timestampPeriod;
+
+    uint32_t num_queue_families=0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device,&num_queue_families,nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(num_queue_families);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device,&num_queue_families,queue_families.data());
+    timestamp_valid_bits=queue_family_index<num_queue_families?queue_families[queue_family_index].timestampValidBits:0;
+
+    if(timestamp_valid_bits==0){
+        std::cout<<"gpu profiling disabled, queue family "<<queue_family_index<<" does not support timestamps"<<std::endl;
+        return;
+    }
+
+    // two queries (begin and end) per scope
+    auto query_pool_create_info=VkQueryPoolCreateInfo{
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        nullptr,
+        0,
+        VK_QUERY_TYPE_TIMESTAMP,
+        num_frames*max_scopes_per_frame*2,
+        0
+    };
+    auto res=vkCreateQueryPool(device,&query_pool_create_info,allocator,&query_pool);
+    VulkanError::check(VulkanErrorContext::CreateQueryPool,res);
+}
+
+GpuProfiler::~GpuProfiler(){
+    if(query_pool!=VK_NULL_HANDLE){
+        vkDestroyQueryPool(device,query_pool,allocator);
+    }
+}
+
+void GpuProfiler::read_back(uint32_t frame_index){
+    auto &frame=frames[frame_index];
+    if(!frame.recorded || frame.scope_names.empty()){
+        return;
+    }
+
+    uint32_t num_queries=static_cast<uint32_t>(frame.scope_names.size())*2;
+    std::vector<TimestampResult> results(num_queries);
+    // no wait bit, VK_NOT_READY only means that some queries are unavailable, which is checked per query below
+    auto res=vkGetQueryPoolResults(
+        device,
+        query_pool,
+        frame_index*max_scopes_per_frame*2,
+        num_queries,
+        results.size()*sizeof(TimestampResult),
+        results.data(),
+        sizeof(TimestampResult),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+    );
+    if(res!=VK_SUCCESS && res!=VK_NOT_READY){
+        throw VulkanError(VulkanErrorContext::GetQueryPoolResults,res);
+    }
+
+    uint64_t timestamp_mask=timestamp_valid_bits>=64?UINT64_MAX:(1ull<<timestamp_valid_bits)-1;
+
+    // scopes with the same name are summed, e.g. a pass recorded several times per frame
+    std::map<std::string,double> frame_ms;
+    for(size_t scope=0;scope<frame.scope_names.size();scope++){
+        const auto &begin=results[2*scope];
+        const auto &end=results[2*scope+1];
+        if(!begin.available || !end.available){
+            continue;
+        }
+        uint64_t ticks=(end.timestamp-begin.timestamp)&timestamp_mask;
+        frame_ms[frame.scope_names[scope]]+=static_cast<double>(ticks)*timestamp_period*1e-6;
+    }
+
+    for(const auto &[name,ms]:frame_ms){
+        auto &scope_history=history[name];
+        if(scope_history.samples_ms.size()<HISTORY_LENGTH){
+            scope_history.samples_ms.push_back(ms);
+            scope_history.next_sample=static_cast<uint32_t>(scope_history.samples_ms.size()%HISTORY_LENGTH);
+        }else{
+            scope_history.samples_ms[scope_history.next_sample]=ms;
+            scope_history.next_sample=(scope_history.next_sample+1)%HISTORY_LENGTH;
+        }
+    }
+}
+
+void GpuProfiler::begin_frame(uint32_t frame_index,VkCommandBuffer command_buffer){
+    if(!supported()){
+        return;
+    }
+
+    read_back(frame_index);
+
+    auto &frame=frames[frame_index];
+    frame.scope_names.clear();
+    frame.recorded=true;
+    current_frame=frame_index;
+
+    vkCmdResetQueryPool(command_buffer,query_pool,frame_index*max_scopes_per_frame*2,max_scopes_per_frame*2);
+}
+
+void GpuProfiler::reset_history(){
+    history.clear();
+    // results of the slots are only read back when they are reused
+    for(auto &frame:frames){
+        frame.recorded=false;
+    }
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer command_buffer,const char *name){
+    if(!supported()){
+        return NO_SCOPE;
+    }
+
+    auto &frame=frames[current_frame];
+    if(frame.scope_names.size()>=max_scopes_per_frame){
+        return NO_SCOPE;
+    }
+
+    uint32_t scope=static_cast<uint32_t>(frame.scope_names.size());
+    frame.scope_names.push_back(name);
+    vkCmdWriteTimestamp(command_buffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,query_pool,(current_frame*max_scopes_per_frame+scope)*2);
+    return scope;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer command_buffer,uint32_t token){
+    if(token==NO_SCOPE){
+        return;
+    }
+
+    vkCmdWriteTimestamp(command_buffer,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,query_pool,(current_frame*max_scopes_per_frame+token)*2+1);
+}
+
+std::vector<GpuScopeTimings> GpuProfiler::timings()const{
+    std::vector<GpuScopeTimings> scope_timings;
+    for(const auto &[name,scope_history]:history){
+        const auto &samples=scope_history.samples_ms;
+        if(samples.empty()){
+            continue;
+        }
+
+        auto sorted_samples=samples;
+        std::sort(sorted_samples.begin(),sorted_samples.end());
+        double sum=0.0;
+        for(auto sample:sorted_samples){
+            sum+=sample;
+        }
+        size_t p99_index=static_cast<size_t>(std::ceil(0.99*static_cast<double>(sorted_samples.size())))-1;
+
+        scope_timings.push_back(GpuScopeTimings{
+            name,
+            static_cast<uint32_t>(samples.size()),
+            sorted_samples.front(),
+            sum/static_cast<double>(sorted_samples.size()),
+            sorted_samples[p99_index],
+            samples[(scope_history.next_sample+samples.size()-1)%samples.size()]
+        });
+    }
+    return scope_timings;
+}
+
+void GpuProfiler::print_report()const{
+    if(!supported()){
+        return;
+    }
+
+    print_timings(timings());
+}
+
+void GpuProfiler::print_timings(const std::vector<GpuScopeTimings> &timings){
+    std::cout<<"gpu timings (ms, last "<<HISTORY_LENGTH<<" frames):"<<std::endl;
+    char line[160];
+    std::snprintf(line,sizeof(line),"  %-24s %8s %8s %8s %8s",
+        "scope","min","avg","p99","samples");
+    std::cout<<line<<std::endl;
+    for(const auto &scope_timings:timings){
+        std::snprintf(line,sizeof(line),"  %-24s %8.3f %8.3f %8.3f %8u",
+            scope_timings.name.c_str(),
+            scope_timings.min_ms,
+            scope_timings.avg_ms,
+            scope_timings.p99_ms,
+            scope_timings.num_samples
+        );
+        std::cout<<line<<std::endl;
+    }
+}
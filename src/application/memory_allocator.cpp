@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <application/memory_allocator.h>
+#include <application/vulkan_error.h>
+
+static VkDeviceSize align_up(VkDeviceSize value,VkDeviceSize alignment){
+    return (value+alignment-1)/alignment*alignment;
+}
+
+/// index of the size class that fits size with alignment, -1 if the allocation is too large for any size class
+static int32_t size_class_index_for(VkDeviceSize size,VkDeviceSize alignment){
+    VkDeviceSize needed=std::max(size,alignment);
+    if(needed>DeviceMemoryAllocator::MAX_SIZE_CLASS){
+        return -1;
+    }
+    int32_t index=0;
+    for(VkDeviceSize slot_size=DeviceMemoryAllocator::MIN_SIZE_CLASS;slot_size<needed;slot_size*=2){
+        index++;
+    }
+    return index;
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(
+    VkDevice device,
+    VkAllocationCallbacks *allocator,
+    VkPhysicalDevice physical_device
+):device(device),allocator(allocator),dedicated_stats(VK_MAX_MEMORY_TYPES){
+    vkGetPhysicalDeviceMemoryProperties(physical_device,&memory_properties);
+
+    VkPhysicalDeviceProperties physical_device_properties;
+    vkGetPhysicalDeviceProperties(physical_device,&physical_device_properties);
+    max_memory_allocation_count=physical_device_properties.limits.maxMemoryAllocationCount;
+
+    for(uint32_t memory_type_index=0;memory_type_index<memory_properties.memoryTypeCount;memory_type_index++){
+        auto heap_size=memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type_index].heapIndex].size;
+        // small heaps (e.g. the 256MB host visible device local heap without resizable bar) get proportionally smaller blocks
+        block_size[memory_type_index]=std::min(DEFAULT_BLOCK_SIZE,std::max(SLAB_SIZE,heap_size/8/SLAB_SIZE*SLAB_SIZE));
+
+        for(auto &pool:pools[memory_type_index]){
+            for(VkDeviceSize slot_size=MIN_SIZE_CLASS;slot_size<=MAX_SIZE_CLASS;slot_size*=2){
+                pool.size_classes.push_back(SizeClass{slot_size,{}});
+            }
+        }
+    }
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator(){
+    for(uint32_t memory_type_index=0;memory_type_index<memory_properties.memoryTypeCount;memory_type_index++){
+        if(dedicated_stats[memory_type_index].num_dedicated_allocations>0){
+            std::cout<<"warning - "<<dedicated_stats[memory_type_index].num_dedicated_allocations<<" dedicated allocations of memory type "<<memory_type_index<<" were not freed"<<std::endl;
+        }
+        for(auto &pool:pools[memory_type_index]){
+            for(auto &block:pool.blocks){
+                if(!block){
+                    continue;
+                }
+                free_device_memory(block->memory);
+            }
+        }
+    }
+}
+
+VkDeviceMemory DeviceMemoryAllocator::allocate_device_memory(uint32_t memory_type_index,VkDeviceSize size,void **mapped){
+    if(num_device_memory_allocations>=max_memory_allocation_count){
+        std::cout<<"maxMemoryAllocationCount of "<<max_memory_allocation_count<<" reached"<<std::endl;
+        throw VulkanError(VulkanErrorContext::AllocateMemory,VK_ERROR_TOO_MANY_OBJECTS);
+    }
+
+    *mapped=nullptr;
+
+    auto memory_allocate_info=VkMemoryAllocateInfo{
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        nullptr,
+        size,
+        memory_type_index
+    };
+    VkDeviceMemory memory;
+    auto res=vkAllocateMemory(device,&memory_allocate_info,allocator,&memory);
+    if(res==VK_ERROR_OUT_OF_DEVICE_MEMORY || res==VK_ERROR_OUT_OF_HOST_MEMORY){
+        return VK_NULL_HANDLE;
+    }
+    VulkanError::check(VulkanErrorContext::AllocateMemory,res);
+    num_device_memory_allocations++;
+
+    if(memory_properties.memoryTypes[memory_type_index].propertyFlags&VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+        res=vkMapMemory(device,memory,0,VK_WHOLE_SIZE,0,mapped);
+        if(res!=VK_SUCCESS){
+            free_device_memory(memory);
+        }
+        VulkanError::check(VulkanErrorContext::MapMemory,res);
+    }
+
+    return memory;
+}
+
+void DeviceMemoryAllocator::free_device_memory(VkDeviceMemory memory){
+    // freeing implicitly unmaps
+    vkFreeMemory(device,memory,allocator);
+    num_device_memory_allocations--;
+}
+
+bool DeviceMemoryAllocator::allocate_from_block(Block &block,VkDeviceSize size,VkDeviceSize alignment,VkDeviceSize &offset){
+    for(auto free_range=block.free_ranges.begin();free_range!=block.free_ranges.end();free_range++){
+        auto [range_offset,range_size]=*free_range;
+        auto aligned_offset=align_up(range_offset,alignment);
+        if(aligned_offset+size>range_offset+range_size){
+            continue;
+        }
+
+        block.free_ranges.erase(free_range);
+        if(aligned_offset>range_offset){
+            block.free_ranges[range_offset]=aligned_offset-range_offset;
+        }
+        if(aligned_offset+size<range_offset+range_size){
+            block.free_ranges[aligned_offset+size]=range_offset+range_size-(aligned_offset+size);
+        }
+
+        block.num_allocations++;
+        offset=aligned_offset;
+        return true;
+    }
+    return false;
+}
+
+void DeviceMemoryAllocator::free_to_block(Block &block,VkDeviceSize offset,VkDeviceSize size){
+    auto inserted=block.free_ranges.emplace(offset,size).first;
+
+    auto next=std::next(inserted);
+    if(next!=block.free_ranges.end() && inserted->first+inserted->second==next->first){
+        inserted->second+=next->second;
+        block.free_ranges.erase(next);
+    }
+    if(inserted!=block.free_ranges.begin()){
+        auto previous=std::prev(inserted);
+        if(previous->first+previous->second==inserted->first){
+            previous->second+=inserted->second;
+            block.free_ranges.erase(inserted);
+        }
+    }
+
+    block.num_allocations--;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate_dedicated(uint32_t memory_type_index,bool linear,VkDeviceSize size){
+    MemoryAllocation allocation;
+    allocation.memory_type_index=memory_type_index;
+    allocation.linear=linear;
+    allocation.size=size;
+    allocation.memory=allocate_device_memory(memory_type_index,size,&allocation.mapped);
+    if(allocation.memory!=VK_NULL_HANDLE){
+        dedicated_stats[memory_type_index].num_dedicated_allocations++;
+        dedicated_stats[memory_type_index].dedicated_bytes+=size;
+    }
+    return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate_from_pool(uint32_t memory_type_index,bool linear,VkDeviceSize size,VkDeviceSize alignment){
+    auto &pool=pools[memory_type_index][linear];
+
+    MemoryAllocation allocation;
+    allocation.memory_type_index=memory_type_index;
+    allocation.linear=linear;
+    allocation.size=size;
+
+    for(int32_t block_index=0;block_index<static_cast<int32_t>(pool.blocks.size());block_index++){
+        auto &block=pool.blocks[block_index];
+        if(block && allocate_from_block(*block,size,alignment,allocation.offset)){
+            allocation.memory=block->memory;
+            allocation.block_index=block_index;
+            if(block->mapped){
+                allocation.mapped=static_cast<char*>(block->mapped)+allocation.offset;
+            }
+            return allocation;
+        }
+    }
+
+    auto block=std::make_unique<Block>();
+    block->size=block_size[memory_type_index];
+    block->memory=allocate_device_memory(memory_type_index,block->size,&block->mapped);
+    if(block->memory==VK_NULL_HANDLE){
+        return allocation;
+    }
+    block->free_ranges[0]=block->size;
+
+    // reuse slots of trimmed blocks, so that block indices of live allocations stay valid
+    auto empty_slot=std::find(pool.blocks.begin(),pool.blocks.end(),nullptr);
+    if(empty_slot==pool.blocks.end()){
+        empty_slot=pool.blocks.insert(pool.blocks.end(),nullptr);
+    }
+    *empty_slot=std::move(block);
+    allocation.block_index=static_cast<int32_t>(empty_slot-pool.blocks.begin());
+
+    auto &new_block=*pool.blocks[allocation.block_index];
+    // a fresh block always has room, since allocations of more than half a block are dedicated
+    allocate_from_block(new_block,size,alignment,allocation.offset);
+    allocation.memory=new_block.memory;
+    if(new_block.mapped){
+        allocation.mapped=static_cast<char*>(new_block.mapped)+allocation.offset;
+    }
+    return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate_from_size_class(uint32_t memory_type_index,bool linear,int32_t size_class_index){
+    auto &size_class=pools[memory_type_index][linear].size_classes[size_class_index];
+
+    int32_t slab_index=-1;
+    for(int32_t i=0;i<static_cast<int32_t>(size_class.slabs.size());i++){
+        if(size_class.slabs[i].backing.memory!=VK_NULL_HANDLE && !size_class.slabs[i].free_slots.empty()){
+            slab_index=i;
+            break;
+        }
+    }
+
+    if(slab_index==-1){
+        // slots are aligned to their size, which is a power of two at least as large as the requested alignment
+        auto backing=allocate_from_pool(memory_type_index,linear,SLAB_SIZE,size_class.slot_size);
+        if(backing.memory==VK_NULL_HANDLE){
+            MemoryAllocation allocation;
+            allocation.memory_type_index=memory_type_index;
+            return allocation;
+        }
+
+        Slab slab;
+        slab.backing=backing;
+        slab.num_slots=static_cast<uint32_t>(SLAB_SIZE/size_class.slot_size);
+        // hand out low offsets first
+        for(uint32_t slot=slab.num_slots;slot>0;slot--){
+            slab.free_slots.push_back(slot-1);
+        }
+
+        for(int32_t i=0;i<static_cast<int32_t>(size_class.slabs.size());i++){
+            if(size_class.slabs[i].backing.memory==VK_NULL_HANDLE){
+                slab_index=i;
+                break;
+            }
+        }
+        if(slab_index==-1){
+            slab_index=static_cast<int32_t>(size_class.slabs.size());
+            size_class.slabs.emplace_back();
+        }
+        size_class.slabs[slab_index]=std::move(slab);
+    }
+
+    auto &slab=size_class.slabs[slab_index];
+    uint32_t slot=slab.free_slots.back();
+    slab.free_slots.pop_back();
+
+    MemoryAllocation allocation;
+    allocation.memory=slab.backing.memory;
+    allocation.offset=slab.backing.offset+slot*size_class.slot_size;
+    allocation.size=size_class.slot_size;
+    if(slab.backing.mapped){
+        allocation.mapped=static_cast<char*>(slab.backing.mapped)+slot*size_class.slot_size;
+    }
+    allocation.memory_type_index=memory_type_index;
+    allocation.linear=linear;
+    allocation.block_index=slab.backing.block_index;
+    allocation.size_class_index=size_class_index;
+    allocation.slab_index=slab_index;
+    return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate(
+    const VkMemoryRequirements &requirements,
+    VkMemoryPropertyFlags required_properties,
+    VkMemoryPropertyFlags preferred_properties,
+    bool linear
+){
+    // memory types with the preferred properties first, in the order the driver lists them (i.e. best first)
+    std::vector<uint32_t> candidate_memory_types;
+    for(auto properties:{required_properties|preferred_properties,required_properties}){
+        for(uint32_t memory_type_index=0;memory_type_index<memory_properties.memoryTypeCount;memory_type_index++){
+            bool allowed=requirements.memoryTypeBits&(1u<<memory_type_index);
+            bool has_properties=(memory_properties.memoryTypes[memory_type_index].propertyFlags&properties)==properties;
+            bool already_listed=std::find(candidate_memory_types.begin(),candidate_memory_types.end(),memory_type_index)!=candidate_memory_types.end();
+            if(allowed && has_properties && !already_listed){
+                candidate_memory_types.push_back(memory_type_index);
+            }
+        }
+    }
+    if(candidate_memory_types.empty()){
+        throw std::runtime_error("no suitable memory type found");
+    }
+
+    for(auto memory_type_index:candidate_memory_types){
+        MemoryAllocation allocation;
+        int32_t size_class_index=size_class_index_for(requirements.size,requirements.alignment);
+        if(requirements.size>block_size[memory_type_index]/2){
+            allocation=allocate_dedicated(memory_type_index,linear,requirements.size);
+        }else if(size_class_index!=-1){
+            allocation=allocate_from_size_class(memory_type_index,linear,size_class_index);
+        }else{
+            allocation=allocate_from_pool(memory_type_index,linear,requirements.size,requirements.alignment);
+        }
+
+        if(allocation.memory!=VK_NULL_HANDLE){
+            return allocation;
+        }
+    }
+
+    throw VulkanError(VulkanErrorContext::AllocateMemory,VK_ERROR_OUT_OF_DEVICE_MEMORY);
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation &allocation){
+    if(allocation.memory==VK_NULL_HANDLE){
+        return;
+    }
+
+    if(allocation.block_index==-1){
+        free_device_memory(allocation.memory);
+        dedicated_stats[allocation.memory_type_index].num_dedicated_allocations--;
+        dedicated_stats[allocation.memory_type_index].dedicated_bytes-=allocation.size;
+    }else{
+        auto &pool=pools[allocation.memory_type_index][allocation.linear];
+        if(allocation.size_class_index!=-1){
+            auto &size_class=pool.size_classes[allocation.size_class_index];
+            auto &slab=size_class.slabs[allocation.slab_index];
+            slab.free_slots.push_back(static_cast<uint32_t>((allocation.offset-slab.backing.offset)/size_class.slot_size));
+        }else{
+            free_to_block(*pool.blocks[allocation.block_index],allocation.offset,allocation.size);
+        }
+    }
+
+    allocation=MemoryAllocation{};
+}
+
+void DeviceMemoryAllocator::trim(){
+    for(uint32_t memory_type_index=0;memory_type_index<memory_properties.memoryTypeCount;memory_type_index++){
+        for(auto &pool:pools[memory_type_index]){
+            // slabs first, since they hold on to block ranges
+            for(auto &size_class:pool.size_classes){
+                for(auto &slab:size_class.slabs){
+                    if(slab.backing.memory!=VK_NULL_HANDLE && slab.free_slots.size()==slab.num_slots){
+                        free_to_block(*pool.blocks[slab.backing.block_index],slab.backing.offset,slab.backing.size);
+                        slab=Slab{};
+                    }
+                }
+            }
+            for(auto &block:pool.blocks){
+                if(block && block->num_allocations==0){
+                    free_device_memory(block->memory);
+                    block.reset();
+                }
+            }
+        }
+    }
+}
+
+MemoryTypeStats DeviceMemoryAllocator::stats(uint32_t memory_type_index)const{
+    MemoryTypeStats stats=dedicated_stats[memory_type_index];
+    for(const auto &pool:pools[memory_type_index]){
+        for(const auto &block:pool.blocks){
+            if(!block){
+                continue;
+            }
+            stats.num_blocks++;
+            stats.block_bytes+=block->size;
+            stats.num_allocations+=block->num_allocations;
+
+            VkDeviceSize block_free_bytes=0;
+            for(auto [offset,size]:block->free_ranges){
+                block_free_bytes+=size;
+                stats.largest_free_range=std::max(stats.largest_free_range,size);
+            }
+            stats.free_bytes+=block_free_bytes;
+            stats.allocated_bytes+=block->size-block_free_bytes;
+        }
+
+        // a slab is a single allocation from its block, but only its occupied slots are in use
+        for(const auto &size_class:pool.size_classes){
+            for(const auto &slab:size_class.slabs){
+                if(slab.backing.memory==VK_NULL_HANDLE){
+                    continue;
+                }
+                auto num_free_slots=static_cast<uint32_t>(slab.free_slots.size());
+                stats.num_allocations+=slab.num_slots-num_free_slots-1;
+                stats.allocated_bytes-=num_free_slots*size_class.slot_size;
+                stats.free_bytes+=num_free_slots*size_class.slot_size;
+            }
+        }
+    }
+    return stats;
+}
+
+void DeviceMemoryAllocator::print_stats()const{
+    std::cout<<"device memory: "<<num_device_memory_allocations<<" of "<<max_memory_allocation_count<<" allocations"<<std::endl;
+    for(uint32_t memory_type_index=0;memory_type_index<memory_properties.memoryTypeCount;memory_type_index++){
+        auto type_stats=stats(memory_type_index);
+        if(type_stats.num_blocks==0 && type_stats.num_dedicated_allocations==0){
+            continue;
+        }
+
+        // share of free block memory that is not part of the largest free range, 0 means no fragmentation
+        double fragmentation=0.0;
+        if(type_stats.free_bytes>0){
+            fragmentation=1.0-static_cast<double>(type_stats.largest_free_range)/static_cast<double>(type_stats.free_bytes);
+        }
+
+        std::cout<<"  memory type "<<memory_type_index<<" (flags "<<memory_properties.memoryTypes[memory_type_index].propertyFlags<<"):"<<std::endl;
+        std::cout<<"    "<<type_stats.num_blocks<<" blocks, "<<(type_stats.block_bytes>>10)<<"KB"<<std::endl;
+        std::cout<<"    "<<type_stats.num_allocations<<" allocations, "<<(type_stats.allocated_bytes>>10)<<"KB used, "<<(type_stats.free_bytes>>10)<<"KB free, fragmentation "<<fragmentation<<std::endl;
+        std::cout<<"    "<<type_stats.num_dedicated_allocations<<" dedicated allocations, "<<(type_stats.dedicated_bytes>>10)<<"KB"<<std::endl;
+    }
+}
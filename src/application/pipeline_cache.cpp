@@ -0,0 +1,225 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+#include <unistd.h>
+
+#include <application/pipeline_cache.h>
+#include <application/vulkan_error.h>
+
+static double milliseconds_since(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+}
+
+/// check that data was produced by the same device (and driver, via the pipeline cache uuid)
+static bool is_valid_cache_data(
+    const std::vector<char> &data,
+    const VkPhysicalDeviceProperties &properties
+){
+    // header layout is fixed by the spec, VkPipelineCacheHeaderVersionOne would be padded differently on some compilers
+    const size_t header_size=16+VK_UUID_SIZE;
+    if(data.size()<header_size){
+        return false;
+    }
+
+    uint32_t header_length,header_version,vendor_id,device_id;
+    std::memcpy(&header_length,data.data()+0,4);
+    std::memcpy(&header_version,data.data()+4,4);
+    std::memcpy(&vendor_id,data.data()+8,4);
+    std::memcpy(&device_id,data.data()+12,4);
+
+    return header_length>=header_size
+        && header_length<=data.size()
+        && header_version==VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && vendor_id==properties.vendorID
+        && device_id==properties.deviceID
+        && std::memcmp(data.data()+16,properties.pipelineCacheUUID,VK_UUID_SIZE)==0;
+}
+
+PipelineCache::PipelineCache(
+    VkDevice device,
+    VkAllocationCallbacks *allocator,
+    VkPhysicalDevice physical_device,
+    std::string directory,
+    bool use_creation_feedback
+):device(device),allocator(allocator),use_creation_feedback(use_creation_feedback){
+    auto load_start=std::chrono::steady_clock::now();
+
+    vkGetPhysicalDeviceProperties(physical_device,&physical_device_properties);
+
+    std::ostringstream filename;
+    filename<<directory<<"/pipeline_cache_"
+        <<std::hex<<std::setfill('0')
+        <<std::setw(4)<<physical_device_properties.vendorID<<"_"
+        <<std::setw(4)<<physical_device_properties.deviceID<<"_"
+        <<std::setw(8)<<physical_device_properties.driverVersion<<"_";
+    for(uint32_t i=0;i<VK_UUID_SIZE;i++){
+        filename<<std::setw(2)<<static_cast<uint32_t>(physical_device_properties.pipelineCacheUUID[i]);
+    }
+    filename<<".bin";
+    filepath=filename.str();
+
+    std::vector<char> cache_data;
+    std::ifstream cache_file{filepath,std::ios::binary};
+    if(cache_file){
+        cache_file.seekg(0,std::ios::end);
+        auto cache_file_size=cache_file.tellg();
+        cache_file.seekg(0,std::ios::beg);
+
+        cache_data.resize(cache_file_size);
+        cache_file.read(cache_data.data(),cache_file_size);
+
+        if(!cache_file || !is_valid_cache_data(cache_data,physical_device_properties)){
+            std::cout<<"ignoring invalid pipeline cache "<<filepath<<std::endl;
+            cache_data.clear();
+        }
+    }
+    loaded_from_disk=!cache_data.empty();
+
+    auto pipeline_cache_create_info=VkPipelineCacheCreateInfo{
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        nullptr,
+        0,
+        cache_data.size(),
+        cache_data.data()
+    };
+    auto res=vkCreatePipelineCache(device,&pipeline_cache_create_info,allocator,&handle);
+    VulkanError::check(VulkanErrorContext::CreatePipelineCache,res);
+
+    stats.load_milliseconds=milliseconds_since(load_start);
+}
+
+PipelineCache::~PipelineCache(){
+    vkDestroyPipelineCache(device,handle,allocator);
+}
+
+void PipelineCache::save(){
+    auto save_start=std::chrono::steady_clock::now();
+
+    size_t cache_data_size=0;
+    auto res=vkGetPipelineCacheData(device,handle,&cache_data_size,nullptr);
+    VulkanError::check(VulkanErrorContext::GetPipelineCacheData,res);
+    std::vector<char> cache_data(cache_data_size);
+    res=vkGetPipelineCacheData(device,handle,&cache_data_size,cache_data.data());
+    VulkanError::check(VulkanErrorContext::GetPipelineCacheData,res);
+    cache_data.resize(cache_data_size);
+
+    // write to a temporary file next to the cache first, so that concurrent jobs never read a partially written
+    // cache. the name is unique per save, so that concurrent saves do not write into the same temporary file
+    std::string temp_filepath=filepath+".XXXXXX";
+    int temp_file_descriptor=mkstemp(temp_filepath.data());
+    if(temp_file_descriptor<0){
+        std::cout<<"failed to create temporary pipeline cache "<<temp_filepath<<std::endl;
+        return;
+    }
+    close(temp_file_descriptor);
+    {
+        std::ofstream cache_file{temp_filepath,std::ios::binary|std::ios::trunc};
+        cache_file.write(cache_data.data(),cache_data.size());
+        // write errors may only show up when the buffered data is flushed
+        cache_file.close();
+        if(!cache_file){
+            std::cout<<"failed to write pipeline cache "<<temp_filepath<<std::endl;
+            std::remove(temp_filepath.c_str());
+            return;
+        }
+    }
+    if(std::rename(temp_filepath.c_str(),filepath.c_str())!=0){
+        std::cout<<"failed to replace pipeline cache "<<filepath<<std::endl;
+        std::remove(temp_filepath.c_str());
+        return;
+    }
+
+    stats.save_milliseconds=milliseconds_since(save_start);
+}
+
+void PipelineCache::record_creation(
+    const char *name,
+    double milliseconds,
+    const VkPipelineCreationFeedbackEXT &feedback
+){
+    const char *result="";
+    if(!(feedback.flags&VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)){
+        stats.num_unknown++;
+        stats.unknown_milliseconds+=milliseconds;
+    }else if(feedback.flags&VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT){
+        stats.num_hits++;
+        stats.hit_milliseconds+=milliseconds;
+        result=" (cache hit)";
+    }else{
+        stats.num_misses++;
+        stats.miss_milliseconds+=milliseconds;
+        result=" (cache miss)";
+    }
+    std::cout<<"created pipeline "<<name<<" in "<<milliseconds<<"ms"<<result<<std::endl;
+}
+
+VkResult PipelineCache::create_graphics_pipeline(
+    const VkGraphicsPipelineCreateInfo &create_info,
+    VkPipeline &pipeline,
+    const char *name
+){
+    VkPipelineCreationFeedbackEXT feedback{0,0};
+    std::vector<VkPipelineCreationFeedbackEXT> stage_feedbacks(create_info.stageCount,VkPipelineCreationFeedbackEXT{0,0});
+    auto feedback_create_info=VkPipelineCreationFeedbackCreateInfoEXT{
+        VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        create_info.pNext,
+        &feedback,
+        static_cast<uint32_t>(stage_feedbacks.size()),
+        stage_feedbacks.data()
+    };
+    auto chained_create_info=create_info;
+    if(use_creation_feedback){
+        chained_create_info.pNext=&feedback_create_info;
+    }
+
+    auto start=std::chrono::steady_clock::now();
+    auto res=vkCreateGraphicsPipelines(device,handle,1,&chained_create_info,allocator,&pipeline);
+    if(res==VK_SUCCESS){
+        record_creation(name,milliseconds_since(start),feedback);
+    }
+    return res;
+}
+
+VkResult PipelineCache::create_compute_pipeline(
+    const VkComputePipelineCreateInfo &create_info,
+    VkPipeline &pipeline,
+    const char *name
+){
+    VkPipelineCreationFeedbackEXT feedback{0,0};
+    VkPipelineCreationFeedbackEXT stage_feedback{0,0};
+    auto feedback_create_info=VkPipelineCreationFeedbackCreateInfoEXT{
+        VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        create_info.pNext,
+        &feedback,
+        1,
+        &stage_feedback
+    };
+    auto chained_create_info=create_info;
+    if(use_creation_feedback){
+        chained_create_info.pNext=&feedback_create_info;
+    }
+
+    auto start=std::chrono::steady_clock::now();
+    auto res=vkCreateComputePipelines(device,handle,1,&chained_create_info,allocator,&pipeline);
+    if(res==VK_SUCCESS){
+        record_creation(name,milliseconds_since(start),feedback);
+    }
+    return res;
+}
+
+void PipelineCache::print_stats()const{
+    std::cout<<"pipeline cache "<<filepath<<(loaded_from_disk?" (loaded)":" (cold)")<<std::endl;
+    std::cout<<"  load "<<stats.load_milliseconds<<"ms, save "<<stats.save_milliseconds<<"ms"<<std::endl;
+    std::cout<<"  "<<stats.num_hits<<" hits in "<<stats.hit_milliseconds<<"ms"<<std::endl;
+    std::cout<<"  "<<stats.num_misses<<" misses in "<<stats.miss_milliseconds<<"ms"<<std::endl;
+    if(stats.num_unknown>0){
+        std::cout<<"  "<<stats.num_unknown<<" without feedback in "<<stats.unknown_milliseconds<<"ms"<<std::endl;
+    }
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <application/shader_registry.h>
+#include <application/vulkan_error.h>
+
+#ifdef EMBED_SHADERS
+// generated by build_shaders, each defines const uint32_t <name>_spv[]
+#include <vertex_shader.spv.h>
+#include <fragment_shader.spv.h>
+#include <slime_init.spv.h>
+#include <slime_agents.spv.h>
+#include <slime_diffuse.spv.h>
+
+static const EmbeddedShader embedded_shaders[]={
+    {"vertex_shader.spv",vertex_shader_spv,sizeof(vertex_shader_spv)},
+    {"fragment_shader.spv",fragment_shader_spv,sizeof(fragment_shader_spv)},
+    {"slime_init.spv",slime_init_spv,sizeof(slime_init_spv)},
+    {"slime_agents.spv",slime_agents_spv,sizeof(slime_agents_spv)},
+    {"slime_diffuse.spv",slime_diffuse_spv,sizeof(slime_diffuse_spv)},
+};
+#endif
+
+static uint64_t fnv1a(const uint32_t *code,size_t size){
+    uint64_t hash=0xcbf29ce484222325ull;
+    auto bytes=reinterpret_cast<const uint8_t*>(code);
+    for(size_t i=0;i<size;i++){
+        hash^=bytes[i];
+        hash*=0x100000001b3ull;
+    }
+    return hash;
+}
+
+static const EmbeddedShader* find_embedded_shader([[maybe_unused]] const std::string &name){
+    #ifdef EMBED_SHADERS
+    for(const auto &embedded_shader:embedded_shaders){
+        if(name==embedded_shader.name){
+            return &embedded_shader;
+        }
+    }
+    #endif
+    return nullptr;
+}
+
+VkShaderModule ShaderRegistry::create_module(const uint32_t *code,size_t size){
+    auto hash=fnv1a(code,size);
+    auto [first_module,last_module]=modules_by_hash.equal_range(hash);
+    for(auto existing_module=first_module;existing_module!=last_module;existing_module++){
+        const auto &existing_code=existing_module->second.code;
+        if(existing_code.size()*4==size && std::equal(existing_code.begin(),existing_code.end(),code)){
+            return existing_module->second.module;
+        }
+    }
+
+    VkShaderModuleCreateInfo shader_module_create_info{
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        nullptr,
+        0,
+        size,
+        code
+    };
+    VkShaderModule shader_module;
+    auto res=vkCreateShaderModule(
+        device,
+        &shader_module_create_info,
+        allocator,
+        &shader_module
+    );
+    VulkanError::check(VulkanErrorContext::CreateShaderModule,res);
+
+    modules_by_hash.emplace(hash,HashedModule{std::vector<uint32_t>(code,code+size/4),shader_module});
+    return shader_module;
+}
+
+VkShaderModule ShaderRegistry::get(const std::string &name){
+    auto existing_module=modules_by_name.find(name);
+    if(existing_module!=modules_by_name.end()){
+        return existing_module->second;
+    }
+
+    VkShaderModule shader_module;
+    if(auto embedded_shader=find_embedded_shader(name)){
+        shader_module=create_module(embedded_shader->code,embedded_shader->size);
+    }else{
+        int fd=open(name.c_str(),O_RDONLY);
+        if(fd<0){
+            throw std::runtime_error("shader file "+name+" does not exist");
+        }
+        struct stat file_stat;
+        if(fstat(fd,&file_stat)!=0 || file_stat.st_size==0 || file_stat.st_size%4!=0){
+            close(fd);
+            throw std::runtime_error("shader file "+name+" is not valid SPIR-V");
+        }
+        size_t size=static_cast<size_t>(file_stat.st_size);
+
+        // mappings are page aligned, so the code can be passed to the driver as is
+        void *mapping=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+        close(fd);
+        if(mapping==MAP_FAILED){
+            throw std::runtime_error("failed to map shader file "+name);
+        }
+
+        try{
+            shader_module=create_module(static_cast<const uint32_t*>(mapping),size);
+        }catch(...){
+            munmap(mapping,size);
+            throw;
+        }
+        munmap(mapping,size);
+    }
+
+    modules_by_name[name]=shader_module;
+    return shader_module;
+}
+
+void ShaderRegistry::clear(){
+    for(const auto &[hash,hashed_module]:modules_by_hash){
+        vkDestroyShaderModule(device,hashed_module.module,allocator);
+    }
+    modules_by_hash.clear();
+    modules_by_name.clear();
+}
+
+ShaderRegistry::~ShaderRegistry(){
+    clear();
+}
@@ -0,0 +1,719 @@
+#include <algorithm>
+#include <cstring>
+
+#include <application.h>
+#include <application/simulation.h>
+#include <application/gpu_profiler.h>
+
+/// number of agent workgroups along x and y, see agent_index() in slime_common.glsl
+static void agent_dispatch_size(
+    uint32_t num_agents,
+    uint32_t &group_count_x,
+    uint32_t &group_count_y
+){
+    const uint32_t AGENT_WORKGROUP_SIZE=256;
+    // minimum guaranteed value of maxComputeWorkGroupCount
+    const uint32_t MAX_GROUP_COUNT=65535;
+
+    uint32_t group_count=(num_agents+AGENT_WORKGROUP_SIZE-1)/AGENT_WORKGROUP_SIZE;
+    group_count_x=std::min(group_count,MAX_GROUP_COUNT);
+    group_count_y=(group_count+group_count_x-1)/group_count_x;
+}
+
+SlimeSimulation::SlimeSimulation(
+    std::shared_ptr<VulkanContext> vulkan,
+    VkQueue queue,
+    uint32_t queue_family_index,
+    const SimulationParameters &parameters
+):vulkan(vulkan),parameters(parameters){
+    const VkFormat TRAIL_FORMAT=VK_FORMAT_R32_SFLOAT;
+
+    vulkan->create_buffer(
+        // matches struct Agent in slime_common.glsl
+        static_cast<VkDeviceSize>(parameters.num_agents)*sizeof(Agent),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        agent_buffer,
+        agent_buffer_memory
+    );
+    vulkan->create_buffer(
+        sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        step_counter_buffer,
+        step_counter_buffer_memory
+    );
+    for(int i=0;i<2;i++){
+        vulkan->create_image(
+            parameters.trail_width,
+            parameters.trail_height,
+            TRAIL_FORMAT,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            trail_images[i],
+            trail_images_memory[i],
+            trail_image_views[i]
+        );
+    }
+
+    // linear filtering of 32 bit float images is optional
+    VkFormatProperties trail_format_properties;
+    vkGetPhysicalDeviceFormatProperties(vulkan->physical_device,TRAIL_FORMAT,&trail_format_properties);
+    VkFilter trail_filter=VK_FILTER_NEAREST;
+    if(trail_format_properties.optimalTilingFeatures&VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT){
+        trail_filter=VK_FILTER_LINEAR;
+    }
+    auto sampler_create_info=VkSamplerCreateInfo{
+        VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        nullptr,
+        0,
+        trail_filter,
+        trail_filter,
+        VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        0.0,
+        VK_FALSE,
+        1.0,
+        VK_FALSE,
+        VK_COMPARE_OP_ALWAYS,
+        0.0,
+        0.0,
+        VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+        VK_FALSE
+    };
+    auto res=vkCreateSampler(vulkan->device,&sampler_create_info,vulkan->allocator,&trail_sampler);
+    VulkanError::check(VulkanErrorContext::CreateSampler,res);
+
+    std::vector<VkDescriptorSetLayoutBinding> compute_descriptor_set_layout_bindings{
+        VkDescriptorSetLayoutBinding{
+            0,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            nullptr
+        },
+        VkDescriptorSetLayoutBinding{
+            1,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            nullptr
+        },
+        VkDescriptorSetLayoutBinding{
+            2,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            nullptr
+        },
+        VkDescriptorSetLayoutBinding{
+            3,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            nullptr
+        },
+    };
+    auto compute_descriptor_set_layout_create_info=VkDescriptorSetLayoutCreateInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        nullptr,
+        0,
+        static_cast<uint32_t>(compute_descriptor_set_layout_bindings.size()),
+        compute_descriptor_set_layout_bindings.data()
+    };
+    res=vkCreateDescriptorSetLayout(vulkan->device,&compute_descriptor_set_layout_create_info,vulkan->allocator,&compute_descriptor_set_layout);
+    VulkanError::check(VulkanErrorContext::CreateDescriptorSetLayout,res);
+
+    std::vector<VkDescriptorSetLayoutBinding> render_descriptor_set_layout_bindings{
+        VkDescriptorSetLayoutBinding{
+            0,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            1,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            nullptr
+        },
+    };
+    auto render_descriptor_set_layout_create_info=VkDescriptorSetLayoutCreateInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        nullptr,
+        0,
+        static_cast<uint32_t>(render_descriptor_set_layout_bindings.size()),
+        render_descriptor_set_layout_bindings.data()
+    };
+    res=vkCreateDescriptorSetLayout(vulkan->device,&render_descriptor_set_layout_create_info,vulkan->allocator,&render_descriptor_set_layout);
+    VulkanError::check(VulkanErrorContext::CreateDescriptorSetLayout,res);
+
+    std::vector<VkDescriptorPoolSize> descriptor_pool_sizes{
+        VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,4},
+        VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,4},
+        VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,2},
+    };
+    auto descriptor_pool_create_info=VkDescriptorPoolCreateInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        nullptr,
+        0,
+        4,
+        static_cast<uint32_t>(descriptor_pool_sizes.size()),
+        descriptor_pool_sizes.data()
+    };
+    res=vkCreateDescriptorPool(vulkan->device,&descriptor_pool_create_info,vulkan->allocator,&descriptor_pool);
+    VulkanError::check(VulkanErrorContext::CreateDescriptorPool,res);
+
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts{
+        compute_descriptor_set_layout,
+        compute_descriptor_set_layout,
+        render_descriptor_set_layout,
+        render_descriptor_set_layout,
+    };
+    auto descriptor_set_allocate_info=VkDescriptorSetAllocateInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        nullptr,
+        descriptor_pool,
+        static_cast<uint32_t>(descriptor_set_layouts.size()),
+        descriptor_set_layouts.data()
+    };
+    std::vector<VkDescriptorSet> descriptor_sets(descriptor_set_layouts.size());
+    res=vkAllocateDescriptorSets(vulkan->device,&descriptor_set_allocate_info,descriptor_sets.data());
+    VulkanError::check(VulkanErrorContext::AllocateDescriptorSets,res);
+    for(int i=0;i<2;i++){
+        compute_descriptor_sets[i]=descriptor_sets[i];
+        render_descriptor_sets[i]=descriptor_sets[2+i];
+    }
+
+    auto agent_buffer_info=VkDescriptorBufferInfo{
+        agent_buffer,
+        0,
+        VK_WHOLE_SIZE
+    };
+    auto step_counter_buffer_info=VkDescriptorBufferInfo{
+        step_counter_buffer,
+        0,
+        VK_WHOLE_SIZE
+    };
+    VkDescriptorImageInfo trail_storage_image_infos[2];
+    VkDescriptorImageInfo trail_sampled_image_infos[2];
+    for(int i=0;i<2;i++){
+        trail_storage_image_infos[i]=VkDescriptorImageInfo{
+            VK_NULL_HANDLE,
+            trail_image_views[i],
+            VK_IMAGE_LAYOUT_GENERAL
+        };
+        trail_sampled_image_infos[i]=VkDescriptorImageInfo{
+            trail_sampler,
+            trail_image_views[i],
+            VK_IMAGE_LAYOUT_GENERAL
+        };
+    }
+    std::vector<VkWriteDescriptorSet> descriptor_writes;
+    for(int i=0;i<2;i++){
+        descriptor_writes.push_back(VkWriteDescriptorSet{
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            nullptr,
+            compute_descriptor_sets[i],
+            0,
+            0,
+            1,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            nullptr,
+            &agent_buffer_info,
+            nullptr
+        });
+        descriptor_writes.push_back(VkWriteDescriptorSet{
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            nullptr,
+            compute_descriptor_sets[i],
+            1,
+            0,
+            1,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            &trail_storage_image_infos[i],
+            nullptr,
+            nullptr
+        });
+        descriptor_writes.push_back(VkWriteDescriptorSet{
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            nullptr,
+            compute_descriptor_sets[i],
+            2,
+            0,
+            1,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            &trail_storage_image_infos[1-i],
+            nullptr,
+            nullptr
+        });
+        descriptor_writes.push_back(VkWriteDescriptorSet{
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            nullptr,
+            compute_descriptor_sets[i],
+            3,
+            0,
+            1,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            nullptr,
+            &step_counter_buffer_info,
+            nullptr
+        });
+        descriptor_writes.push_back(VkWriteDescriptorSet{
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            nullptr,
+            render_descriptor_sets[i],
+            0,
+            0,
+            1,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            &trail_sampled_image_infos[i],
+            nullptr,
+            nullptr
+        });
+    }
+    vkUpdateDescriptorSets(
+        vulkan->device,
+        static_cast<uint32_t>(descriptor_writes.size()),
+        descriptor_writes.data(),
+        0,
+        nullptr
+    );
+
+    std::vector<VkDescriptorSetLayout> compute_pipeline_set_layouts{compute_descriptor_set_layout};
+    init_pipeline=std::make_shared<ComputePipeline>(vulkan,"slime_init.spv",compute_pipeline_set_layouts,sizeof(SimulationPushConstants));
+    agents_pipeline=std::make_shared<ComputePipeline>(vulkan,"slime_agents.spv",compute_pipeline_set_layouts,sizeof(SimulationPushConstants));
+    diffuse_pipeline=std::make_shared<ComputePipeline>(vulkan,"slime_diffuse.spv",compute_pipeline_set_layouts,sizeof(SimulationPushConstants));
+
+    // initialise agents and trail maps with a one-off submission
+    VkCommandPool init_command_pool;
+    auto init_command_pool_create_info=VkCommandPoolCreateInfo{
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        nullptr,
+        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        queue_family_index
+    };
+    res=vkCreateCommandPool(vulkan->device,&init_command_pool_create_info,vulkan->allocator,&init_command_pool);
+    VulkanError::check(VulkanErrorContext::CreateCommandPool,res);
+    auto _=defer([&]()->void{
+        vkDestroyCommandPool(vulkan->device,init_command_pool,vulkan->allocator);
+    });
+
+    VkCommandBuffer init_command_buffer;
+    auto init_command_buffer_allocate_info=VkCommandBufferAllocateInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        nullptr,
+        init_command_pool,
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        1
+    };
+    res=vkAllocateCommandBuffers(vulkan->device,&init_command_buffer_allocate_info,&init_command_buffer);
+    VulkanError::check(VulkanErrorContext::AllocateCommandBuffers,res);
+
+    auto init_command_buffer_begin_info=VkCommandBufferBeginInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        nullptr,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        nullptr
+    };
+    vkBeginCommandBuffer(init_command_buffer,&init_command_buffer_begin_info);
+    {
+        std::vector<VkImageMemoryBarrier> to_transfer_dst_barriers;
+        std::vector<VkImageMemoryBarrier> to_general_barriers;
+        for(int i=0;i<2;i++){
+            to_transfer_dst_barriers.push_back(VkImageMemoryBarrier{
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                nullptr,
+                0,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                trail_images[i],
+                VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT,0,1,0,1}
+            });
+            // trail maps stay in general layout for their whole lifetime, since they are used as storage and sampled images
+            to_general_barriers.push_back(VkImageMemoryBarrier{
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                nullptr,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_GENERAL,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                trail_images[i],
+                VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT,0,1,0,1}
+            });
+        }
+        vkCmdPipelineBarrier(
+            init_command_buffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0,nullptr,
+            0,nullptr,
+            static_cast<uint32_t>(to_transfer_dst_barriers.size()),to_transfer_dst_barriers.data()
+        );
+
+        VkClearColorValue clear_color{};
+        auto clear_range=VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT,0,1,0,1};
+        for(int i=0;i<2;i++){
+            vkCmdClearColorImage(init_command_buffer,trail_images[i],VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,&clear_color,1,&clear_range);
+        }
+        vkCmdFillBuffer(init_command_buffer,step_counter_buffer,0,sizeof(uint32_t),static_cast<uint32_t>(step_index));
+
+        auto step_counter_initialized_barrier=VkMemoryBarrier{
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            nullptr,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        };
+        vkCmdPipelineBarrier(
+            init_command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0,
+            1,&step_counter_initialized_barrier,
+            0,nullptr,
+            static_cast<uint32_t>(to_general_barriers.size()),to_general_barriers.data()
+        );
+
+        auto constants=push_constants();
+        vkCmdBindPipeline(init_command_buffer,VK_PIPELINE_BIND_POINT_COMPUTE,init_pipeline->handle);
+        vkCmdBindDescriptorSets(init_command_buffer,VK_PIPELINE_BIND_POINT_COMPUTE,init_pipeline->layout,0,1,&compute_descriptor_sets[0],0,nullptr);
+        vkCmdPushConstants(init_command_buffer,init_pipeline->layout,VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(constants),&constants);
+        uint32_t group_count_x,group_count_y;
+        agent_dispatch_size(parameters.num_agents,group_count_x,group_count_y);
+        vkCmdDispatch(init_command_buffer,group_count_x,group_count_y,1);
+
+        auto agents_initialized_barrier=VkMemoryBarrier{
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            nullptr,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        };
+        vkCmdPipelineBarrier(
+            init_command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1,&agents_initialized_barrier,
+            0,nullptr,
+            0,nullptr
+        );
+    }
+    discard vkEndCommandBuffer(init_command_buffer);
+
+    auto init_submit_info=VkSubmitInfo{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        nullptr,
+        0,
+        nullptr,
+        nullptr,
+        1,
+        &init_command_buffer,
+        0,
+        nullptr
+    };
+    res=vkQueueSubmit(queue,1,&init_submit_info,VK_NULL_HANDLE);
+    VulkanError::check(VulkanErrorContext::QueueSubmit,res);
+    // initialisation only happens once, so waiting here is fine
+    vkQueueWaitIdle(queue);
+}
+
+SlimeSimulation::~SlimeSimulation(){
+    init_pipeline.reset();
+    agents_pipeline.reset();
+    diffuse_pipeline.reset();
+
+    vkDestroyDescriptorPool(vulkan->device,descriptor_pool,vulkan->allocator);
+    vkDestroyDescriptorSetLayout(vulkan->device,compute_descriptor_set_layout,vulkan->allocator);
+    vkDestroyDescriptorSetLayout(vulkan->device,render_descriptor_set_layout,vulkan->allocator);
+
+    vkDestroySampler(vulkan->device,trail_sampler,vulkan->allocator);
+    for(int i=0;i<2;i++){
+        vulkan->destroy_image(trail_images[i],trail_images_memory[i],trail_image_views[i]);
+    }
+
+    vulkan->destroy_buffer(step_counter_buffer,step_counter_buffer_memory);
+    vulkan->destroy_buffer(agent_buffer,agent_buffer_memory);
+}
+
+SimulationPushConstants SlimeSimulation::push_constants()const{
+    return SimulationPushConstants{
+        parameters.num_agents,
+        parameters.trail_width,
+        parameters.trail_height,
+        parameters.seed,
+        parameters.move_speed,
+        parameters.turn_speed,
+        parameters.sensor_angle,
+        parameters.sensor_distance,
+        parameters.sensor_size,
+        parameters.deposit,
+        parameters.decay,
+        parameters.diffuse
+    };
+}
+
+void SlimeSimulation::record_step_dispatches(VkCommandBuffer command_buffer,GpuProfiler *profiler,uint32_t trail_index)const{
+    auto constants=push_constants();
+    auto compute_descriptor_set=compute_descriptor_sets[trail_index];
+
+    // the previous step must be done with the trail maps and the step counter
+    auto step_begin_barrier=VkMemoryBarrier{
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,&step_begin_barrier,
+        0,nullptr,
+        0,nullptr
+    );
+
+    // diffuse and decay into the other trail map, advance the step counter
+    {
+        GpuProfileScope diffuse_scope(profiler,command_buffer,"simulation.diffuse");
+        vkCmdBindPipeline(command_buffer,VK_PIPELINE_BIND_POINT_COMPUTE,diffuse_pipeline->handle);
+        vkCmdBindDescriptorSets(command_buffer,VK_PIPELINE_BIND_POINT_COMPUTE,diffuse_pipeline->layout,0,1,&compute_descriptor_set,0,nullptr);
+        vkCmdPushConstants(command_buffer,diffuse_pipeline->layout,VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(constants),&constants);
+        vkCmdDispatch(
+            command_buffer,
+            (parameters.trail_width+15)/16,
+            (parameters.trail_height+15)/16,
+            1
+        );
+    }
+
+    // agents deposit into the diffused trail map
+    auto diffused_barrier=VkMemoryBarrier{
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,&diffused_barrier,
+        0,nullptr,
+        0,nullptr
+    );
+
+    // sense on the current trail map, rotate, move, deposit into the other trail map
+    {
+        GpuProfileScope agents_scope(profiler,command_buffer,"simulation.agents");
+        vkCmdBindPipeline(command_buffer,VK_PIPELINE_BIND_POINT_COMPUTE,agents_pipeline->handle);
+        vkCmdBindDescriptorSets(command_buffer,VK_PIPELINE_BIND_POINT_COMPUTE,agents_pipeline->layout,0,1,&compute_descriptor_set,0,nullptr);
+        vkCmdPushConstants(command_buffer,agents_pipeline->layout,VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(constants),&constants);
+        uint32_t group_count_x,group_count_y;
+        agent_dispatch_size(parameters.num_agents,group_count_x,group_count_y);
+        vkCmdDispatch(command_buffer,group_count_x,group_count_y,1);
+    }
+}
+
+void SlimeSimulation::prerecord_steps(const VkCommandBuffer command_buffers[2]){
+    // not inside a render pass, nothing is inherited
+    auto inheritance_info=VkCommandBufferInheritanceInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        nullptr,
+        VK_NULL_HANDLE,
+        0,
+        VK_NULL_HANDLE,
+        VK_FALSE,
+        0,
+        0
+    };
+    // executed by several frames in flight, and several times by one frame with more than one step per frame
+    auto step_command_buffer_begin_info=VkCommandBufferBeginInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        nullptr,
+        VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+        &inheritance_info
+    };
+    for(uint32_t trail_index=0;trail_index<2;trail_index++){
+        vkBeginCommandBuffer(command_buffers[trail_index],&step_command_buffer_begin_info);
+        record_step_dispatches(command_buffers[trail_index],nullptr,trail_index);
+        discard vkEndCommandBuffer(command_buffers[trail_index]);
+
+        step_command_buffers[trail_index]=command_buffers[trail_index];
+    }
+}
+
+void SlimeSimulation::record_steps(VkCommandBuffer command_buffer,GpuProfiler *profiler,uint32_t num_steps,bool graphics_queue){
+    if(num_steps==0){
+        return;
+    }
+    GpuProfileScope step_scope(profiler,command_buffer,"simulation");
+
+    // previous frames must be done sampling the trail maps before they are overwritten, which needs no memory dependency
+    // the fragment shader stage does not exist on compute only queues, semaphores order rendering there
+    if(graphics_queue){
+        vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0,nullptr,
+            0,nullptr,
+            0,nullptr
+        );
+    }
+
+    bool prerecorded=step_command_buffers[0]!=VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> executed_command_buffers;
+    for(uint32_t step=0;step<num_steps;step++){
+        if(prerecorded){
+            executed_command_buffers.push_back(step_command_buffers[current_trail_index]);
+        }else{
+            // per kernel scopes would use up the profiler's queries on long batches, which are only timed as a whole
+            record_step_dispatches(command_buffer,num_steps==1?profiler:nullptr,current_trail_index);
+        }
+
+        current_trail_index=1-current_trail_index;
+        step_index++;
+    }
+    if(prerecorded){
+        vkCmdExecuteCommands(command_buffer,static_cast<uint32_t>(executed_command_buffers.size()),executed_command_buffers.data());
+    }
+
+    // a semaphore signal makes the writes available to other queues
+    if(graphics_queue){
+        auto diffuse_barrier=VkMemoryBarrier{
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            nullptr,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT
+        };
+        vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0,
+            1,&diffuse_barrier,
+            0,nullptr,
+            0,nullptr
+        );
+    }
+}
+
+void SlimeSimulation::record_agent_upload(
+    VkCommandBuffer command_buffer,
+    StagingRing &staging_ring,
+    uint32_t first_agent,
+    const std::vector<Agent> &agents
+){
+    if(agents.empty()){
+        return;
+    }
+
+    auto region=staging_ring.allocate(agents.size()*sizeof(Agent),alignof(Agent));
+    std::memcpy(region.mapped,agents.data(),region.size);
+
+    // at most two copies, one up to the end of the agent buffer and one from its start
+    std::vector<VkBufferCopy> copy_regions;
+    uint32_t num_copied=0;
+    while(num_copied<agents.size()){
+        uint32_t dst_agent=(first_agent+num_copied)%parameters.num_agents;
+        uint32_t num_agents=std::min<uint32_t>(static_cast<uint32_t>(agents.size())-num_copied,parameters.num_agents-dst_agent);
+        copy_regions.push_back(VkBufferCopy{
+            region.offset+num_copied*sizeof(Agent),
+            dst_agent*sizeof(Agent),
+            num_agents*sizeof(Agent)
+        });
+        num_copied+=num_agents;
+    }
+    vkCmdCopyBuffer(command_buffer,region.buffer,agent_buffer,static_cast<uint32_t>(copy_regions.size()),copy_regions.data());
+}
+
+void SlimeSimulation::record_trail_readback(
+    VkCommandBuffer command_buffer,
+    StagingRing &staging_ring,
+    std::function<void(const Field2D &trail_map)> callback
+){
+    // rows padded to whole cache lines, like an owning Field2D, so row kernels never straddle two
+    constexpr uint32_t ROW_ALIGNMENT=MatrixAllocator::ALIGNMENT/sizeof(float);
+    uint32_t pitch=(parameters.trail_width+ROW_ALIGNMENT-1)/ROW_ALIGNMENT*ROW_ALIGNMENT;
+    auto region=staging_ring.allocate(
+        static_cast<VkDeviceSize>(pitch)*parameters.trail_height*sizeof(float),
+        MatrixAllocator::ALIGNMENT
+    );
+
+    auto copy_region=VkBufferImageCopy{
+        region.offset,
+        pitch,
+        0,
+        VkImageSubresourceLayers{
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            0,
+            0,
+            1
+        },
+        VkOffset3D{0,0,0},
+        VkExtent3D{parameters.trail_width,parameters.trail_height,1}
+    };
+    // trail maps stay in general layout for their whole lifetime
+    vkCmdCopyImageToBuffer(command_buffer,trail_images[current_trail_index],VK_IMAGE_LAYOUT_GENERAL,region.buffer,1,&copy_region);
+
+    auto host_read_barrier=VkMemoryBarrier{
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_HOST_READ_BIT
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1,&host_read_barrier,
+        0,nullptr,
+        0,nullptr
+    );
+
+    auto width=parameters.trail_width;
+    auto height=parameters.trail_height;
+    staging_ring.on_complete([region,width,height,pitch,callback](){
+        // the view is only handed out as const
+        callback(Field2D::view(static_cast<float*>(region.mapped),width,height,pitch));
+    });
+}
+
+void SlimeSimulation::record_trail_upload(
+    VkCommandBuffer command_buffer,
+    StagingRing &staging_ring,
+    const Field2D &trail_map
+){
+    // same row alignment as readbacks
+    constexpr uint32_t ROW_ALIGNMENT=MatrixAllocator::ALIGNMENT/sizeof(float);
+    uint32_t pitch=(parameters.trail_width+ROW_ALIGNMENT-1)/ROW_ALIGNMENT*ROW_ALIGNMENT;
+    auto region=staging_ring.allocate(
+        static_cast<VkDeviceSize>(pitch)*parameters.trail_height*sizeof(float),
+        MatrixAllocator::ALIGNMENT
+    );
+    Field2D::view(static_cast<float*>(region.mapped),parameters.trail_width,parameters.trail_height,pitch).copy_rows(trail_map);
+
+    uint32_t upload_trail_index=1-current_trail_index;
+    auto copy_region=VkBufferImageCopy{
+        region.offset,
+        pitch,
+        0,
+        VkImageSubresourceLayers{
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            0,
+            0,
+            1
+        },
+        VkOffset3D{0,0,0},
+        VkExtent3D{parameters.trail_width,parameters.trail_height,1}
+    };
+    vkCmdCopyBufferToImage(command_buffer,region.buffer,trail_images[upload_trail_index],VK_IMAGE_LAYOUT_GENERAL,1,&copy_region);
+
+    current_trail_index=upload_trail_index;
+}
@@ -0,0 +1,130 @@
+#include <stdexcept>
+
+#include <application/staging_ring.h>
+#include <application/vulkan_error.h>
+
+static VkDeviceSize align_up(VkDeviceSize value,VkDeviceSize alignment){
+    return (value+alignment-1)/alignment*alignment;
+}
+
+StagingRing::StagingRing(
+    std::shared_ptr<VulkanContext> vulkan,
+    VkDeviceSize size
+):vulkan(vulkan),size(size){
+    // host cached memory makes reading back much faster, and does not hurt uploads
+    vulkan->create_buffer(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        buffer,
+        memory,
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+    );
+}
+
+StagingRing::~StagingRing(){
+    retire(true);
+    vulkan->destroy_buffer(buffer,memory);
+}
+
+VkDeviceSize StagingRing::find_space(VkDeviceSize region_size,VkDeviceSize alignment)const{
+    if(is_empty()){
+        return 0;
+    }
+
+    auto aligned_head=align_up(head,alignment);
+    if(head>=tail){
+        // live regions are [tail,head), so there is space at the end and before tail
+        if(aligned_head+region_size<=size){
+            return aligned_head;
+        }
+        // strictly less, so that head==tail always means empty
+        if(region_size<tail){
+            return 0;
+        }
+    }else{
+        // live regions wrap around, the only space is [head,tail)
+        if(aligned_head+region_size<tail){
+            return aligned_head;
+        }
+    }
+    return UINT64_MAX;
+}
+
+StagingRegion StagingRing::allocate(VkDeviceSize region_size,VkDeviceSize alignment){
+    if(region_size>=size){
+        throw std::runtime_error("staging region larger than the staging ring");
+    }
+
+    auto offset=find_space(region_size,alignment);
+    while(offset==UINT64_MAX){
+        if(submissions.empty()){
+            throw std::runtime_error("staging ring is full of unsubmitted transfers");
+        }
+        vkWaitForFences(vulkan->device,1,&submissions.front().fence,VK_TRUE,UINT64_MAX);
+        retire();
+        offset=find_space(region_size,alignment);
+    }
+
+    if(is_empty()){
+        tail=0;
+    }
+    head=offset+region_size;
+    has_unsubmitted_regions=true;
+
+    return StagingRegion{
+        buffer,
+        offset,
+        region_size,
+        static_cast<char*>(memory.mapped)+offset
+    };
+}
+
+void StagingRing::on_complete(std::function<void()> callback){
+    unsubmitted_callbacks.push_back(std::move(callback));
+}
+
+void StagingRing::submitted(VkFence fence){
+    if(!has_unsubmitted_regions && unsubmitted_callbacks.empty()){
+        return;
+    }
+
+    submissions.push_back(Submission{
+        fence,
+        head,
+        std::move(unsubmitted_callbacks)
+    });
+    unsubmitted_callbacks.clear();
+    has_unsubmitted_regions=false;
+}
+
+void StagingRing::retire(bool wait){
+    while(!submissions.empty()){
+        auto &submission=submissions.front();
+        if(wait){
+            vkWaitForFences(vulkan->device,1,&submission.fence,VK_TRUE,UINT64_MAX);
+        }else if(vkGetFenceStatus(vulkan->device,submission.fence)!=VK_SUCCESS){
+            break;
+        }
+
+        tail=submission.end;
+        auto completion_callbacks=std::move(submission.completion_callbacks);
+        submissions.pop_front();
+
+        for(auto &completion_callback:completion_callbacks){
+            completion_callback();
+        }
+    }
+}
+
+void StagingRing::retire(VkFence fence){
+    // submissions complete in order, so waiting on older fences does not block for long
+    while(!submissions.empty()){
+        bool is_last=submissions.front().fence==fence;
+        vkWaitForFences(vulkan->device,1,&submissions.front().fence,VK_TRUE,UINT64_MAX);
+        retire();
+        if(is_last){
+            break;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include <application/timeline.h>
+#include <application/vulkan_error.h>
+
+Timeline::Timeline(
+    VkDevice device,
+    VkAllocationCallbacks *allocator,
+    uint64_t initial_value
+):device(device),allocator(allocator),submitted_value(initial_value){
+    // the core entry points only exist on vulkan 1.2 devices, the extension ones on all that support it
+    vk_get_semaphore_counter_value=reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+        vkGetDeviceProcAddr(device,"vkGetSemaphoreCounterValueKHR")
+    );
+    vk_wait_semaphores=reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+        vkGetDeviceProcAddr(device,"vkWaitSemaphoresKHR")
+    );
+    if(!vk_get_semaphore_counter_value || !vk_wait_semaphores){
+        throw VulkanError(VulkanErrorContext::CreateSemaphore,VK_ERROR_EXTENSION_NOT_PRESENT);
+    }
+
+    auto semaphore_type_create_info=VkSemaphoreTypeCreateInfo{
+        VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        nullptr,
+        VK_SEMAPHORE_TYPE_TIMELINE,
+        initial_value
+    };
+    auto semaphore_create_info=VkSemaphoreCreateInfo{
+        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        &semaphore_type_create_info,
+        0
+    };
+    auto res=vkCreateSemaphore(device,&semaphore_create_info,allocator,&handle);
+    VulkanError::check(VulkanErrorContext::CreateSemaphore,res);
+}
+
+Timeline::~Timeline(){
+    vkDestroySemaphore(device,handle,allocator);
+}
+
+uint64_t Timeline::completed()const{
+    uint64_t value=0;
+    auto res=vk_get_semaphore_counter_value(device,handle,&value);
+    VulkanError::check(VulkanErrorContext::GetSemaphoreCounterValue,res);
+    return value;
+}
+
+bool Timeline::wait_until(uint64_t value,uint64_t timeout_ns)const{
+    auto wait_info=VkSemaphoreWaitInfo{
+        VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        nullptr,
+        0,
+        1,
+        &handle,
+        &value
+    };
+    auto res=vk_wait_semaphores(device,&wait_info,timeout_ns);
+    if(res==VK_TIMEOUT){
+        return false;
+    }
+    VulkanError::check(VulkanErrorContext::WaitSemaphores,res);
+    return true;
+}
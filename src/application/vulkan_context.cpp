@@ -0,0 +1,129 @@
+#include <application/vulkan_context.h>
+#include <application/vulkan_error.h>
+#include <application/deletion_queue.h>
+
+VkSharingMode VulkanContext::sharing_mode()const{
+    if(resource_queue_family_indices.size()>1){
+        return VK_SHARING_MODE_CONCURRENT;
+    }
+    return VK_SHARING_MODE_EXCLUSIVE;
+}
+
+void VulkanContext::destroy_when_unused(std::function<void()> destroy)const{
+    if(deletion_queue){
+        deletion_queue->defer(std::move(destroy));
+    }else{
+        destroy();
+    }
+}
+
+void VulkanContext::create_buffer(
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags memory_properties,
+    VkBuffer &buffer,
+    MemoryAllocation &buffer_memory,
+    VkMemoryPropertyFlags preferred_memory_properties
+)const{
+    auto buffer_create_info=VkBufferCreateInfo{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        nullptr,
+        0,
+        size,
+        usage,
+        sharing_mode(),
+        static_cast<uint32_t>(resource_queue_family_indices.size()),
+        resource_queue_family_indices.data()
+    };
+    auto res=vkCreateBuffer(device,&buffer_create_info,allocator,&buffer);
+    VulkanError::check(VulkanErrorContext::CreateBuffer,res);
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(device,buffer,&memory_requirements);
+
+    buffer_memory=memory_allocator->allocate(memory_requirements,memory_properties,preferred_memory_properties,true);
+
+    res=vkBindBufferMemory(device,buffer,buffer_memory.memory,buffer_memory.offset);
+    VulkanError::check(VulkanErrorContext::BindBufferMemory,res);
+}
+
+void VulkanContext::destroy_buffer(
+    VkBuffer buffer,
+    MemoryAllocation &buffer_memory
+)const{
+    vkDestroyBuffer(device,buffer,allocator);
+    memory_allocator->free(buffer_memory);
+}
+
+void VulkanContext::create_image(
+    uint32_t width,
+    uint32_t height,
+    VkFormat format,
+    VkImageUsageFlags usage,
+    VkImage &image,
+    MemoryAllocation &image_memory,
+    VkImageView &image_view
+)const{
+    auto image_create_info=VkImageCreateInfo{
+        VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        nullptr,
+        0,
+        VK_IMAGE_TYPE_2D,
+        format,
+        VkExtent3D{width,height,1},
+        1,
+        1,
+        VK_SAMPLE_COUNT_1_BIT,
+        VK_IMAGE_TILING_OPTIMAL,
+        usage,
+        sharing_mode(),
+        static_cast<uint32_t>(resource_queue_family_indices.size()),
+        resource_queue_family_indices.data(),
+        VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    auto res=vkCreateImage(device,&image_create_info,allocator,&image);
+    VulkanError::check(VulkanErrorContext::CreateImage,res);
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(device,image,&memory_requirements);
+
+    // optimal tiling, so the image must not share a pool with buffers
+    image_memory=memory_allocator->allocate(memory_requirements,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,0,false);
+
+    res=vkBindImageMemory(device,image,image_memory.memory,image_memory.offset);
+    VulkanError::check(VulkanErrorContext::BindImageMemory,res);
+
+    auto image_view_create_info=VkImageViewCreateInfo{
+        VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        nullptr,
+        0,
+        image,
+        VK_IMAGE_VIEW_TYPE_2D,
+        format,
+        VkComponentMapping{
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        VkImageSubresourceRange{
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            0,
+            1,
+            0,
+            1
+        }
+    };
+    res=vkCreateImageView(device,&image_view_create_info,allocator,&image_view);
+    VulkanError::check(VulkanErrorContext::CreateImageView,res);
+}
+
+void VulkanContext::destroy_image(
+    VkImage image,
+    MemoryAllocation &image_memory,
+    VkImageView image_view
+)const{
+    vkDestroyImageView(device,image_view,allocator);
+    vkDestroyImage(device,image,allocator);
+    memory_allocator->free(image_memory);
+}
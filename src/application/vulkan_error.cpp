@@ -30,6 +30,23 @@ std::string VulkanError::info()const{
         VK_ERROR_CONTEXT_CASE(CreateCommandPool)
         VK_ERROR_CONTEXT_CASE(AllocateCommandBuffers)
         VK_ERROR_CONTEXT_CASE(CreateGraphicsPipelines)
+        VK_ERROR_CONTEXT_CASE(CreateComputePipelines)
+        VK_ERROR_CONTEXT_CASE(CreateImage)
+        VK_ERROR_CONTEXT_CASE(CreateImageView)
+        VK_ERROR_CONTEXT_CASE(BindImageMemory)
+        VK_ERROR_CONTEXT_CASE(CreateSampler)
+        VK_ERROR_CONTEXT_CASE(QueueSubmit)
+        VK_ERROR_CONTEXT_CASE(CreateFence)
+        VK_ERROR_CONTEXT_CASE(CreateSemaphore)
+        VK_ERROR_CONTEXT_CASE(QueuePresent)
+        VK_ERROR_CONTEXT_CASE(CreateFramebuffer)
+        VK_ERROR_CONTEXT_CASE(CreatePipelineCache)
+        VK_ERROR_CONTEXT_CASE(GetPipelineCacheData)
+        VK_ERROR_CONTEXT_CASE(MapMemory)
+        VK_ERROR_CONTEXT_CASE(CreateQueryPool)
+        VK_ERROR_CONTEXT_CASE(GetQueryPoolResults)
+        VK_ERROR_CONTEXT_CASE(GetSemaphoreCounterValue)
+        VK_ERROR_CONTEXT_CASE(WaitSemaphores)
     }
     res+=context_string;
     res+=" failed";
@@ -1,3 +1,11 @@
+#include<algorithm>
+#include<thread>
+#include<ctime>
+
+#ifdef VK_USE_PLATFORM_XCB_KHR
+#include<poll.h>
+#endif
+
 #include<application.h>
 
 std::string WindowEvent::string()const{
@@ -37,6 +45,8 @@ std::string WindowEvent::string()const{
             return "WindowResizeEvent \{ new_height: "+std::to_string(ev->new_height)+" , new_width: "+std::to_string(ev->new_width)+" }";
         }else if MATCHES(WindowMoveEvent){
             return "WindowMoveEvent \{ new_x: "+std::to_string(ev->new_x)+" , new_y: "+std::to_string(ev->new_y)+" }";
+        }else if MATCHES(WindowExposeEvent){
+            return "WindowExposeEvent";
         }else{
             return "invalid";
         }
@@ -49,10 +59,11 @@ Window::Window(
     std::shared_ptr<VulkanContext> vulkan,
     int width,
     int height,
+    SwapchainPolicy swapchain_policy,
     int x,
     int y,
     int screen_index
-):width(width),height(height),xcb_connection(xcb_connection),vulkan{vulkan}{
+):width(width),height(height),xcb_connection(xcb_connection),vulkan{vulkan},swapchain_policy(swapchain_policy){
     window_handle=xcb_generate_id(xcb_connection);
 
     auto setup=xcb_get_setup(xcb_connection);
@@ -179,7 +190,60 @@ void Window::create_swapchain(){
         &num_surface_formats,
         surface_formats.data()
     );
+
+    // a single undefined format means that the surface has no preference
+    const VkFormat preferred_formats[]={
+        VK_FORMAT_B8G8R8A8_UNORM,
+        VK_FORMAT_R8G8B8A8_UNORM,
+        VK_FORMAT_B8G8R8A8_SRGB,
+        VK_FORMAT_R8G8B8A8_SRGB,
+    };
     vk_swapchain_surface_format=surface_formats[0];
+    if(surface_formats.size()==1 && surface_formats[0].format==VK_FORMAT_UNDEFINED){
+        vk_swapchain_surface_format=VkSurfaceFormatKHR{preferred_formats[0],VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    }else{
+        auto preferred_format=std::find_first_of(
+            std::begin(preferred_formats),std::end(preferred_formats),
+            surface_formats.begin(),surface_formats.end(),
+            [](VkFormat format,const VkSurfaceFormatKHR &surface_format){
+                return surface_format.format==format && surface_format.colorSpace==VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+            }
+        );
+        if(preferred_format!=std::end(preferred_formats)){
+            vk_swapchain_surface_format=VkSurfaceFormatKHR{*preferred_format,VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+        }
+    }
+
+    std::vector<VkPresentModeKHR> preferred_present_modes;
+    switch(swapchain_policy){
+        case SwapchainPolicy::PowerSaving:
+            break;
+        case SwapchainPolicy::LowLatency:
+            preferred_present_modes={VK_PRESENT_MODE_MAILBOX_KHR,VK_PRESENT_MODE_IMMEDIATE_KHR};
+            break;
+        case SwapchainPolicy::MaxThroughput:
+            preferred_present_modes={VK_PRESENT_MODE_IMMEDIATE_KHR,VK_PRESENT_MODE_MAILBOX_KHR};
+            break;
+    }
+    vk_swapchain_present_mode=VK_PRESENT_MODE_FIFO_KHR;
+    for(auto preferred_present_mode:preferred_present_modes){
+        if(std::find(surface_present_modes.begin(),surface_present_modes.end(),preferred_present_mode)!=surface_present_modes.end()){
+            vk_swapchain_present_mode=preferred_present_mode;
+            break;
+        }
+    }
+
+    uint32_t num_images=surface_capabilities.minImageCount;
+    if(swapchain_policy==SwapchainPolicy::MaxThroughput){
+        num_images++;
+    }else if(vk_swapchain_present_mode==VK_PRESENT_MODE_MAILBOX_KHR){
+        // one image on screen, one queued and one to render into
+        num_images=std::max<uint32_t>(num_images,3);
+    }
+    // no maximum if 0
+    if(surface_capabilities.maxImageCount>0){
+        num_images=std::min(num_images,surface_capabilities.maxImageCount);
+    }
 
     auto old_swapchain_handle=vk_swapchain;
     auto swapchain_create_info=VkSwapchainCreateInfoKHR{
@@ -187,7 +251,7 @@ void Window::create_swapchain(){
         nullptr,
         0,
         vk_surface,
-        surface_capabilities.minImageCount,
+        num_images,
         vk_swapchain_surface_format.format,
         vk_swapchain_surface_format.colorSpace,
         surface_capabilities.currentExtent,
@@ -198,7 +262,7 @@ void Window::create_swapchain(){
         nullptr,
         surface_capabilities.currentTransform,
         VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-        surface_present_modes[0],
+        vk_swapchain_present_mode,
         VK_TRUE,
         old_swapchain_handle
     };
@@ -214,7 +278,9 @@ void Window::create_swapchain(){
     }
 
     if(old_swapchain_handle!=VK_NULL_HANDLE){
-        vkDestroySwapchainKHR(vulkan->device,old_swapchain_handle,vulkan->allocator);
+        vulkan->destroy_when_unused([device=vulkan->device,allocator=vulkan->allocator,old_swapchain_handle]{
+            vkDestroySwapchainKHR(device,old_swapchain_handle,allocator);
+        });
     }
 
     uint32_t num_swapchain_images=0;
@@ -252,6 +318,31 @@ xcb_atom_t Window::get_intern_atom(
 }
 #endif
 
+void Window::vulkan_resize(VkRenderPass render_pass){
+    // frames in flight may still reference the old framebuffers
+    if(!vulkan->deletion_queue){
+        vulkan->deviceWaitIdle();
+    }
+    vulkan->destroy_when_unused([
+        device=vulkan->device,
+        allocator=vulkan->allocator,
+        framebuffers=std::move(vk_swapchain_framebuffers),
+        image_views=std::move(vk_swapchain_image_views)
+    ]{
+        for(auto framebuffer:framebuffers){
+            vkDestroyFramebuffer(device,framebuffer,allocator);
+        }
+        for(auto image_view:image_views){
+            vkDestroyImageView(device,image_view,allocator);
+        }
+    });
+    vk_swapchain_framebuffers.clear();
+    vk_swapchain_image_views.clear();
+
+    create_swapchain();
+    create_framebuffers(render_pass);
+}
+
 void Window::create_framebuffers(
     VkRenderPass render_pass
 ){
@@ -321,15 +412,55 @@ void Window::create_framebuffers(
 }
 
 #ifdef VK_USE_PLATFORM_XCB_KHR
-std::vector<WindowEvent> Window::get_latest_events(){
-    std::vector<WindowEventVariant> events;
-    while(auto xcb_event=xcb_poll_for_event(xcb_connection)){
+bool Window::wait_for_events(std::optional<std::chrono::steady_clock::time_point> deadline){
+    if(pending_event){
+        return true;
+    }
+    // other calls on the connection (e.g. presentation) may already have read events from the socket,
+    // those would not wake up poll
+    pending_event=xcb_poll_for_queued_event(xcb_connection);
+    if(pending_event){
+        return true;
+    }
+    // requests that have not been sent yet may be what the server is supposed to respond to
+    flush();
+
+    timespec timeout;
+    if(deadline){
+        auto remaining=std::max(
+            std::chrono::steady_clock::duration::zero(),
+            *deadline-std::chrono::steady_clock::now()
+        );
+        auto seconds=std::chrono::duration_cast<std::chrono::seconds>(remaining);
+        timeout.tv_sec=seconds.count();
+        timeout.tv_nsec=std::chrono::duration_cast<std::chrono::nanoseconds>(remaining-seconds).count();
+    }
+
+    pollfd connection_fd{xcb_get_file_descriptor(xcb_connection),POLLIN,0};
+    // interrupted by a signal counts as woken up, the caller checks its deadline again anyway
+    int res=ppoll(&connection_fd,1,deadline?&timeout:nullptr,nullptr);
+    return res!=0;
+}
+
+std::span<const WindowEvent> Window::get_latest_events(){
+    event_buffer.clear();
+    // an xcb event results in at most two window events, events that do not fit stay queued in xcb
+    while(event_buffer.available()>=2){
+        auto xcb_event=pending_event;
+        pending_event=nullptr;
+        if(!xcb_event){
+            xcb_event=xcb_poll_for_event(xcb_connection);
+        }
+        if(!xcb_event){
+            break;
+        }
+
         auto event_type=xcb_event->response_type&0x7F;
         switch(event_type){
             case XCB_BUTTON_PRESS:{
                 auto button_press_notify_event=*((xcb_button_press_event_t*)xcb_event);
 
-                events.push_back(ButtonPressed{
+                event_buffer.push(ButtonPressed{
                     button_press_notify_event.detail
                 });
                 break;
@@ -337,31 +468,31 @@ std::vector<WindowEvent> Window::get_latest_events(){
             case XCB_BUTTON_RELEASE:{
                 auto button_release_notify_event=*((xcb_button_release_event_t*)xcb_event);
 
-                events.push_back(ButtonReleased{
+                event_buffer.push(ButtonReleased{
                     button_release_notify_event.detail
                 });
                 break;
             }
 
             case XCB_FOCUS_IN:{
-                events.push_back(WindowGainedFocus{});
+                event_buffer.push(WindowGainedFocus{});
                 break;
             }
             case XCB_FOCUS_OUT:{
-                events.push_back(WindowLostFocus{});
+                event_buffer.push(WindowLostFocus{});
                 break;
             }
 
             case XCB_KEY_PRESS:{
                 auto key_release_notify_event=*((xcb_key_press_event_t*)xcb_event);
-                events.push_back(KeyPressed{
+                event_buffer.push(KeyPressed{
                     key_release_notify_event.detail
                 });
                 break;
             }
             case XCB_KEY_RELEASE:{
                 auto key_release_notify_event=*((xcb_key_release_event_t*)xcb_event);
-                events.push_back(KeyReleased{
+                event_buffer.push(KeyReleased{
                     key_release_notify_event.detail
                 });
                 break;
@@ -370,7 +501,7 @@ std::vector<WindowEvent> Window::get_latest_events(){
             case XCB_MOTION_NOTIFY:{
                 auto motion_notify_event=*((xcb_motion_notify_event_t*)xcb_event);
                 
-                events.push_back(PointerMoved{
+                event_buffer.push(PointerMoved{
                     static_cast<float>(motion_notify_event.event_x),
                     static_cast<float>(motion_notify_event.event_y),
                 });
@@ -381,7 +512,7 @@ std::vector<WindowEvent> Window::get_latest_events(){
                 auto client_message_event=*((xcb_client_message_event_t*)xcb_event);
             
                 if(client_message_event.data.data32[0]==wm_delete_atom){
-                    events.push_back(WindowCloseEvent{
+                    event_buffer.push(WindowCloseEvent{
                         window_handle
                     });
                 }
@@ -389,11 +520,11 @@ std::vector<WindowEvent> Window::get_latest_events(){
             }
 
             case XCB_ENTER_NOTIFY:{
-                events.push_back(PointerEnteredWindow{});
+                event_buffer.push(PointerEnteredWindow{});
                 break;
             }
             case XCB_LEAVE_NOTIFY:{
-                events.push_back(PointerExitedWindow{});
+                event_buffer.push(PointerExitedWindow{});
                 break;
             }
 
@@ -401,7 +532,7 @@ std::vector<WindowEvent> Window::get_latest_events(){
                 auto configure_notify_event=*((xcb_configure_notify_event_t*)xcb_event);
 
                 if(configure_notify_event.width!=width || configure_notify_event.height!=height){
-                    events.push_back(WindowResizeEvent{
+                    event_buffer.push(WindowResizeEvent{
                         configure_notify_event.width,
                         configure_notify_event.height
                     });
@@ -411,7 +542,7 @@ std::vector<WindowEvent> Window::get_latest_events(){
                 }
 
                 if(configure_notify_event.x!=screen_x || configure_notify_event.y!=screen_y){
-                    events.push_back(WindowMoveEvent{
+                    event_buffer.push(WindowMoveEvent{
                         configure_notify_event.x,
                         configure_notify_event.y
                     });
@@ -423,7 +554,16 @@ std::vector<WindowEvent> Window::get_latest_events(){
                 break;
             }
             
-            case XCB_EXPOSE:
+            case XCB_EXPOSE:{
+                auto expose_event=*((xcb_expose_event_t*)xcb_event);
+
+                // the last of a series of expose events
+                if(expose_event.count==0){
+                    event_buffer.push(WindowExposeEvent{});
+                }
+                break;
+            }
+
             case XCB_KEYMAP_NOTIFY:
             case XCB_GRAPHICS_EXPOSURE:
             case XCB_NO_EXPOSURE:
@@ -452,13 +592,11 @@ std::vector<WindowEvent> Window::get_latest_events(){
             default:
                 std::cout<<"got unhandled event "<<event_type<<std::endl;
         }
-    }
 
-    std::vector<WindowEvent> window_events;
-    for(auto event_variant:events){
-        window_events.push_back(WindowEvent(event_variant));
+        free(xcb_event);
     }
-    return window_events;
+
+    return event_buffer.span();
 }
 #endif
 
@@ -466,14 +604,27 @@ std::vector<WindowEvent> Window::get_latest_events(){
 
 #include<objc/objc.h>
 
-std::vector<WindowEvent> Window::get_latest_events(){
-    std::vector<WindowEvent> ret{};
-    return ret;
+std::span<const WindowEvent> Window::get_latest_events(){
+    event_buffer.clear();
+    return event_buffer.span();
+}
+
+bool Window::wait_for_events(std::optional<std::chrono::steady_clock::time_point> deadline){
+    // no events are delivered, so there is nothing to wake up for before the deadline
+    if(deadline){
+        std::this_thread::sleep_until(*deadline);
+    }
+    return false;
 }
 #endif
 
 Window::~Window(){
     if(is_non_temp_window()){
+        // swapchains retired by resizing must go before the surface
+        if(vulkan->deletion_queue){
+            vulkan->deletion_queue->flush();
+        }
+
         destroy_image_views();
         destroy_framebuffers();
 
@@ -494,6 +645,9 @@ Window::~Window(){
 }
 #ifdef VK_USE_PLATFORM_XCB_KHR
 void Window::platform_destroy(){
+    free(pending_event);
+    pending_event=nullptr;
+
     xcb_unmap_window(xcb_connection, window_handle);
     xcb_destroy_window(xcb_connection, window_handle);
 
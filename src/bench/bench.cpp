@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <application.h>
+
+/// fixed size simulation run
+struct Workload{
+    uint32_t num_agents;
+    uint32_t trail_width;
+    uint32_t trail_height;
+};
+
+struct WorkloadResult{
+    Workload workload;
+    uint64_t steps;
+    double seconds;
+    double cpu_frame_avg_ms;
+    double cpu_frame_p99_ms;
+    /// steps ran on a compute only queue, see ApplicationOptions::async_compute
+    bool async_compute;
+    /// empty if the device does not support timestamps
+    std::vector<GpuScopeTimings> gpu_timings;
+};
+
+static void print_usage(const char *program_name){
+    std::cout
+        << "usage: " << program_name << " [options]\n"
+        << "  --agents <n,n,...>      agent counts (default 10000,100000,1000000,10000000)\n"
+        << "  --trail <wxh,wxh,...>   trail map resolutions (default 256x256,1024x1024)\n"
+        << "  --steps <n>             measured steps per workload (default 200)\n"
+        << "  --warmup <n>            unmeasured steps before each workload (default 20)\n"
+        << "  --steps-per-frame <n>   simulation steps per submission, drawing only the last (default 1)\n"
+        << "  --seed <n>              seed of the initial agent distribution (default 1)\n"
+        << "  --no-render             only run the simulation, do not draw the trail map\n"
+        << "  --cpu                   run the simulation on the cpu instead of the gpu\n"
+        << "  --cpu-threads <n>       threads of the cpu simulation (default one per hardware thread)\n"
+        << "  --no-async-compute      run simulation steps on the graphics queue\n"
+        << "  --device <index|name>   use this device instead of the highest scoring one\n"
+        << "  --output <file>         write results to file (default bench_results.json, - for stdout)\n"
+        << std::endl;
+}
+
+static std::vector<std::string> split(const std::string &list,char separator){
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while(std::getline(stream,item,separator)){
+        if(!item.empty()){
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static std::string json_string(const std::string &value){
+    std::string escaped="\"";
+    for(char c:value){
+        if(c=='"' || c=='\\'){
+            escaped+='\\';
+            escaped+=c;
+        }else if(static_cast<unsigned char>(c)<0x20){
+            escaped+=' ';
+        }else{
+            escaped+=c;
+        }
+    }
+    return escaped+"\"";
+}
+
+static WorkloadResult run_workload(
+    ApplicationOptions options,
+    const Workload &workload,
+    uint64_t warmup_steps,
+    uint64_t measured_steps,
+    std::string &device_name
+){
+    options.simulation.num_agents=workload.num_agents;
+    options.simulation.trail_width=workload.trail_width;
+    options.simulation.trail_height=workload.trail_height;
+    options.headless_width=workload.trail_width;
+    options.headless_height=workload.trail_height;
+
+    Application application(options);
+    device_name=application.physical_device_properties().deviceName;
+
+    // a frame runs up to steps_per_frame steps
+    while(application.step_index()<warmup_steps){
+        application.run_step();
+    }
+    application.wait_idle();
+    // gpu timings of the warmup would otherwise remain in the profiler history
+    application.reset_gpu_timings();
+
+    std::vector<double> cpu_frame_ms;
+    cpu_frame_ms.reserve(measured_steps);
+
+    uint64_t first_step=application.step_index();
+    auto start=std::chrono::steady_clock::now();
+    while(application.step_index()-first_step<measured_steps){
+        auto frame_start=std::chrono::steady_clock::now();
+        application.run_step();
+        cpu_frame_ms.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-frame_start).count());
+    }
+    application.wait_idle();
+    measured_steps=application.step_index()-first_step;
+    auto seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    double cpu_frame_sum_ms=0.0;
+    for(auto ms:cpu_frame_ms){
+        cpu_frame_sum_ms+=ms;
+    }
+    std::sort(cpu_frame_ms.begin(),cpu_frame_ms.end());
+
+    WorkloadResult result{
+        workload,
+        measured_steps,
+        seconds,
+        cpu_frame_ms.empty()?0.0:cpu_frame_sum_ms/static_cast<double>(cpu_frame_ms.size()),
+        cpu_frame_ms.empty()?0.0:cpu_frame_ms[(cpu_frame_ms.size()*99+99)/100-1],
+        application.async_compute_enabled(),
+        {}
+    };
+    // gpu timings only cover measured frames, at most the last GpuProfiler::HISTORY_LENGTH of them.
+    // the last frames in flight are not read back yet and therefore missing
+    result.gpu_timings=application.gpu_timings();
+    return result;
+}
+
+static void write_results(std::ostream &out,const std::string &device_name,const std::string &backend,uint32_t steps_per_frame,const std::vector<WorkloadResult> &results){
+    out<<"{\n";
+    out<<"  \"device\": "<<json_string(device_name)<<",\n";
+    out<<"  \"backend\": "<<json_string(backend)<<",\n";
+    out<<"  \"steps_per_frame\": "<<steps_per_frame<<",\n";
+    out<<"  \"workloads\": [\n";
+    for(size_t i=0;i<results.size();i++){
+        const auto &result=results[i];
+        double steps_per_second=static_cast<double>(result.steps)/result.seconds;
+
+        out<<"    {\n";
+        out<<"      \"agents\": "<<result.workload.num_agents<<",\n";
+        out<<"      \"trail_width\": "<<result.workload.trail_width<<",\n";
+        out<<"      \"trail_height\": "<<result.workload.trail_height<<",\n";
+        out<<"      \"steps\": "<<result.steps<<",\n";
+        out<<"      \"async_compute\": "<<(result.async_compute?"true":"false")<<",\n";
+        out<<"      \"seconds\": "<<result.seconds<<",\n";
+        out<<"      \"steps_per_second\": "<<steps_per_second<<",\n";
+        out<<"      \"agent_steps_per_second\": "<<steps_per_second*result.workload.num_agents<<",\n";
+        out<<"      \"cpu_frame_ms\": {\"avg\": "<<result.cpu_frame_avg_ms<<", \"p99\": "<<result.cpu_frame_p99_ms<<"},\n";
+        out<<"      \"gpu_ms\": {";
+        for(size_t scope=0;scope<result.gpu_timings.size();scope++){
+            const auto &timings=result.gpu_timings[scope];
+            out<<(scope>0?", ":"")<<json_string(timings.name)
+                <<": {\"min\": "<<timings.min_ms
+                <<", \"avg\": "<<timings.avg_ms
+                <<", \"p99\": "<<timings.p99_ms
+                <<", \"samples\": "<<timings.num_samples<<"}";
+        }
+        out<<"}\n";
+        out<<"    }"<<(i+1<results.size()?",":"")<<"\n";
+    }
+    out<<"  ]\n";
+    out<<"}"<<std::endl;
+}
+
+int main(int argc, char *argv[]){
+    std::vector<uint32_t> agent_counts{10000,100000,1000000,10000000};
+    std::vector<std::pair<uint32_t,uint32_t>> trail_sizes{{256,256},{1024,1024}};
+    uint64_t measured_steps=200;
+    uint64_t warmup_steps=20;
+    std::string output_path="bench_results.json";
+
+    ApplicationOptions options;
+    options.headless=true;
+    options.frame_pacing=FramePacing::Uncapped;
+    // the benchmark must also run on machines without a gpu, the highest scoring device still wins if there is one
+    options.device_selection.allow_cpu=true;
+
+    for(int i=1;i<argc;i++){
+        std::string arg=argv[i];
+        bool has_value=i+1<argc;
+
+        if(arg=="--agents" && has_value){
+            agent_counts.clear();
+            for(const auto &count:split(argv[++i],',')){
+                agent_counts.push_back(std::stoul(count));
+            }
+        }else if(arg=="--trail" && has_value){
+            trail_sizes.clear();
+            for(const auto &size:split(argv[++i],',')){
+                auto dimensions=split(size,'x');
+                if(dimensions.size()!=2){
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                trail_sizes.push_back({std::stoul(dimensions[0]),std::stoul(dimensions[1])});
+            }
+        }else if(arg=="--steps" && has_value){
+            measured_steps=std::stoull(argv[++i]);
+        }else if(arg=="--warmup" && has_value){
+            warmup_steps=std::stoull(argv[++i]);
+        }else if(arg=="--seed" && has_value){
+            options.simulation.seed=std::stoul(argv[++i]);
+        }else if(arg=="--steps-per-frame" && has_value){
+            options.steps_per_frame=std::stoul(argv[++i]);
+        }else if(arg=="--no-render"){
+            options.headless_render=false;
+        }else if(arg=="--cpu"){
+            options.simulation_backend=SimulationBackend::Cpu;
+        }else if(arg=="--cpu-threads" && has_value){
+            options.cpu_simulation_threads=std::stoul(argv[++i]);
+        }else if(arg=="--no-async-compute"){
+            options.async_compute=false;
+        }else if(arg=="--device" && has_value){
+            std::string device=argv[++i];
+            bool is_index=!device.empty() && device.find_first_not_of("0123456789")==std::string::npos;
+            if(is_index){
+                options.device_selection.device_index=std::stoul(device);
+            }else{
+                options.device_selection.device_name=device;
+            }
+        }else if(arg=="--output" && has_value){
+            output_path=argv[++i];
+        }else{
+            print_usage(argv[0]);
+            return arg=="--help"?0:1;
+        }
+    }
+
+    // the application logs to stdout, which must only contain the results if they are written there
+    std::ostream results_stdout(std::cout.rdbuf());
+    if(output_path=="-"){
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    std::string backend=options.simulation_backend==SimulationBackend::Cpu?"cpu":"gpu";
+    std::string device_name;
+    std::vector<WorkloadResult> results;
+    for(auto [trail_width,trail_height]:trail_sizes){
+        for(auto num_agents:agent_counts){
+            std::cerr<<"running "<<num_agents<<" agents on "<<trail_width<<"x"<<trail_height<<std::endl;
+            results.push_back(run_workload(
+                options,
+                Workload{num_agents,trail_width,trail_height},
+                warmup_steps,
+                measured_steps,
+                device_name
+            ));
+        }
+    }
+
+    if(output_path=="-"){
+        write_results(results_stdout,device_name,backend,options.steps_per_frame,results);
+    }else{
+        std::ofstream output_file(output_path);
+        if(!output_file){
+            std::cerr<<"failed to open "<<output_path<<std::endl;
+            return 1;
+        }
+        write_results(output_file,device_name,backend,options.steps_per_frame,results);
+        std::cerr<<"results written to "<<output_path<<std::endl;
+    }
+}
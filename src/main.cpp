@@ -1,4 +1,5 @@
 /*#include <iostream>
+#include <chrono>
 #include <cstdio>
 #include <matrix.hpp>
 #include <application.h>*/
@@ -24,11 +25,69 @@
             << std::endl;
     }
     {
+        // gemm throughput, 2*n^3 flops per multiply
+        auto benchmark_gemm=[](auto &a,auto &b,index_t n){
+            auto start=std::chrono::steady_clock::now();
+            auto c=a*b;
+            double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            std::cout
+                << n << "x" << n << " gemm " << seconds*1e3 << " ms, "
+                << 2.0*n*n*n/seconds*1e-9 << " GFLOP/s on " << ThreadPool::global().num_threads() << " threads"
+                << " (checksum " << c.sum() << ")"
+                << std::endl;
+        };
+        {
+            constexpr index_t MSIZE=1024;
+            Matrix<MSIZE,MSIZE> a(1),b(2);
+            benchmark_gemm(a,b,MSIZE);
+        }
+        {
+            constexpr index_t MSIZE=2048;
+            Matrix<MSIZE,MSIZE> a(1),b(2);
+            benchmark_gemm(a,b,MSIZE);
+        }
+        {
+            constexpr index_t MSIZE=4096;
+            Matrix<MSIZE,MSIZE> a(1),b(2);
+            benchmark_gemm(a,b,MSIZE);
+        }
+    }
+    {
+        // Mat4 against the generic Matrix<4,4> path, both chained so the compiler cannot drop iterations
+        constexpr int ITERATIONS=10000000;
+        constexpr Mat4 rotation=Mat4(
+            Vec4(0.0f,1.0f,0.0f,0.0f),
+            Vec4(-1.0f,0.0f,0.0f,0.0f),
+            Vec4(0.0f,0.0f,1.0f,0.0f),
+            Vec4(0.0f,0.0f,0.0f,1.0f)
+        );
+        static_assert(rotation*rotation.inverse()==Mat4::identity());
 
+        auto start=std::chrono::steady_clock::now();
+        Mat4 small=Mat4::identity();
+        for(int i=0;i<ITERATIONS;i++){
+            small=small*rotation;
+        }
+        double small_seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+        start=std::chrono::steady_clock::now();
+        Matrix<4,4> generic=Mat4::identity().matrix();
+        Matrix<4,4> generic_rotation=rotation.matrix();
+        for(int i=0;i<ITERATIONS;i++){
+            generic=generic*generic_rotation;
+        }
+        double generic_seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
 
-        Vec3 v{1.0f};
-        std::cout<<v.string()<<std::endl;
-        std::cout<<v.transposed().string()<<std::endl;
+        std::cout
+            << "4x4 multiply: Mat4 " << small_seconds/ITERATIONS*1e9 << " ns, "
+            << "Matrix<4,4> " << generic_seconds/ITERATIONS*1e9 << " ns"
+            << " (checksums " << small.matrix().sum() << " " << generic.sum() << ")"
+            << std::endl;
+    }
+    {
+        constexpr Vec3 v{1.0f};
+        std::cout<<v.matrix().string()<<std::endl;
+        std::cout<<v.matrix().transposed().string()<<std::endl;
 
         auto m1=Matrix<2,3>{{
             1,4,
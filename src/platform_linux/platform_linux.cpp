@@ -1,6 +1,127 @@
+#include <iostream>
+#include <string>
+
 #include <application.h>
 
+static void print_usage(const char *program_name){
+    std::cout
+        << "usage: " << program_name << " [options]\n"
+        << "  --frames-in-flight <n>  number of frames the cpu may record ahead of the gpu (default 2)\n"
+        << "  --vsync                 present in sync with the display (default)\n"
+        << "  --uncapped              render as fast as possible\n"
+        << "  --fps <n>               render at most n frames per second\n"
+        << "  --swapchain <policy>    power-saving (fifo), low-latency (mailbox) or max-throughput (immediate)\n"
+        << "                          (default power-saving with --vsync, otherwise low-latency)\n"
+        << "  --poll-events           poll window events once per frame instead of waiting for them\n"
+        << "  --device <index|name>   use this device instead of the highest scoring one\n"
+        << "  --allow-cpu             also consider software vulkan implementations\n"
+        << "  --pipeline-cache <dir>  directory for the pipeline cache (default .)\n"
+        << "  --no-pipeline-cache     always compile pipelines from scratch\n"
+        << "  --no-gpu-profile        do not measure gpu time per pass\n"
+        << "  --gpu-report <n>        print gpu timings every n steps (default only on exit)\n"
+        << "  --headless              render into an offscreen image, no display required\n"
+        << "  --size <w> <h>          offscreen image size in headless mode (default 500 500)\n"
+        << "  --no-render             in headless mode, only run the simulation\n"
+        << "  --steps <n>             exit after n simulation steps\n"
+        << "  --steps-per-frame <n>   run n simulation steps per submission, drawing only the last (default 1)\n"
+        << "  --agents <n>            number of simulated agents (default 1048576)\n"
+        << "  --trail <w> <h>         trail map resolution (default 500 500)\n"
+        << "  --seed <n>              seed of the initial agent distribution (default 1)\n"
+        << "  --cpu                   run the simulation on the cpu, the gpu only draws the trail map\n"
+        << "  --cpu-threads <n>       threads of the cpu simulation (default one per hardware thread)\n"
+        << "  --no-async-compute      run simulation steps on the graphics queue\n"
+        << "  --dump-trail <n>        write the trail map to a pfm file every n steps\n"
+        << "  --dump-dir <dir>        directory for trail map files (default .)\n"
+        << "  --spawn <n>             number of agents spawned per click (default 4096)\n"
+        << "\n"
+        << "press space to pause and resume the simulation\n"
+        << std::endl;
+}
+
 int main(int argc, char *argv[]){
-    Application app;
+    ApplicationOptions options;
+
+    for(int i=1;i<argc;i++){
+        std::string arg=argv[i];
+        bool has_value=i+1<argc;
+
+        if(arg=="--frames-in-flight" && has_value){
+            options.frames_in_flight=std::stoul(argv[++i]);
+        }else if(arg=="--vsync"){
+            options.frame_pacing=FramePacing::VSync;
+        }else if(arg=="--uncapped"){
+            options.frame_pacing=FramePacing::Uncapped;
+        }else if(arg=="--fps" && has_value){
+            options.frame_pacing=FramePacing::TargetFps;
+            options.target_fps=std::stod(argv[++i]);
+        }else if(arg=="--swapchain" && has_value){
+            std::string policy=argv[++i];
+            if(policy=="power-saving"){
+                options.swapchain_policy=SwapchainPolicy::PowerSaving;
+            }else if(policy=="low-latency"){
+                options.swapchain_policy=SwapchainPolicy::LowLatency;
+            }else if(policy=="max-throughput"){
+                options.swapchain_policy=SwapchainPolicy::MaxThroughput;
+            }else{
+                print_usage(argv[0]);
+                return 1;
+            }
+        }else if(arg=="--poll-events"){
+            options.wait_for_events=false;
+        }else if(arg=="--device" && has_value){
+            std::string device=argv[++i];
+            bool is_index=!device.empty() && device.find_first_not_of("0123456789")==std::string::npos;
+            if(is_index){
+                options.device_selection.device_index=std::stoul(device);
+            }else{
+                options.device_selection.device_name=device;
+            }
+        }else if(arg=="--allow-cpu"){
+            options.device_selection.allow_cpu=true;
+        }else if(arg=="--pipeline-cache" && has_value){
+            options.pipeline_cache_directory=argv[++i];
+        }else if(arg=="--no-pipeline-cache"){
+            options.pipeline_cache_directory.clear();
+        }else if(arg=="--no-gpu-profile"){
+            options.gpu_profiling=false;
+        }else if(arg=="--gpu-report" && has_value){
+            options.gpu_profile_report_interval=std::stoull(argv[++i]);
+        }else if(arg=="--headless"){
+            options.headless=true;
+        }else if(arg=="--size" && i+2<argc){
+            options.headless_width=std::stoul(argv[++i]);
+            options.headless_height=std::stoul(argv[++i]);
+        }else if(arg=="--no-render"){
+            options.headless_render=false;
+        }else if(arg=="--steps" && has_value){
+            options.max_steps=std::stoull(argv[++i]);
+        }else if(arg=="--steps-per-frame" && has_value){
+            options.steps_per_frame=std::stoul(argv[++i]);
+        }else if(arg=="--agents" && has_value){
+            options.simulation.num_agents=std::stoul(argv[++i]);
+        }else if(arg=="--trail" && i+2<argc){
+            options.simulation.trail_width=std::stoul(argv[++i]);
+            options.simulation.trail_height=std::stoul(argv[++i]);
+        }else if(arg=="--seed" && has_value){
+            options.simulation.seed=std::stoul(argv[++i]);
+        }else if(arg=="--cpu"){
+            options.simulation_backend=SimulationBackend::Cpu;
+        }else if(arg=="--cpu-threads" && has_value){
+            options.cpu_simulation_threads=std::stoul(argv[++i]);
+        }else if(arg=="--no-async-compute"){
+            options.async_compute=false;
+        }else if(arg=="--dump-trail" && has_value){
+            options.trail_readback_interval=std::stoull(argv[++i]);
+        }else if(arg=="--dump-dir" && has_value){
+            options.trail_readback_directory=argv[++i];
+        }else if(arg=="--spawn" && has_value){
+            options.agents_per_click=std::stoul(argv[++i]);
+        }else{
+            print_usage(argv[0]);
+            return arg=="--help"?0:1;
+        }
+    }
+
+    Application app(options);
     app.run_forever();
 }
\ No newline at end of file
@@ -68,10 +68,11 @@ Window::Window(
     std::shared_ptr<VulkanContext> vulkan,
     int width,
     int height,
+    SwapchainPolicy swapchain_policy,
     int x,
     int y,
     int screen_index
-):width(width),height(height),vulkan{vulkan}{
+):width(width),height(height),vulkan{vulkan},swapchain_policy(swapchain_policy){
     MyWindow *window=[
         [MyWindow alloc]
         initWithContentRect:NSMakeRect(0, 0, static_cast<CGFloat>(width), static_cast<CGFloat>(height))
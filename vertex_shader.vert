@@ -4,6 +4,10 @@ out gl_PerVertex{
     vec4 gl_Position;
 };
 
+layout(location=0) out vec2 o_uv;
+
+// single triangle covering the whole viewport, no vertex buffer required
 void main(){
-    gl_Position=vec4(0.0,0.0,0.0,0.0);
+    o_uv=vec2((gl_VertexIndex<<1)&2,gl_VertexIndex&2);
+    gl_Position=vec4(o_uv*2.0-1.0,0.0,1.0);
 }
\ No newline at end of file